@@ -0,0 +1,350 @@
+#include "earbrain/completion.hpp"
+#include "earbrain/logging.hpp"
+#include "earbrain/metrics.hpp"
+#include "earbrain/task_helpers.hpp"
+#include "earbrain/task_pool.hpp"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_cpu.h"
+#endif
+
+// Host (IDF linux target) and device runs share this file. Per-operation
+// costs are measured inside one task, in CPU cycles on the device and in
+// nanoseconds on the host; hand-offs between tasks may cross cores, so they
+// are measured in microseconds of the monotonic clock instead.
+
+namespace {
+
+constexpr const char *bench_tag = "bench";
+
+#if CONFIG_IDF_TARGET_LINUX
+constexpr const char *cycle_unit = "ns";
+uint32_t cycles() {
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+#else
+constexpr const char *cycle_unit = "cycles";
+uint32_t cycles() { return esp_cpu_get_cycle_count(); }
+#endif
+
+int64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Every operator new in the image goes through here, so allocations made
+// by the library show up per operation.
+std::atomic<uint32_t> allocation_count{0};
+std::atomic<uint32_t> allocation_bytes{0};
+
+struct Allocations {
+  uint32_t count;
+  uint32_t bytes;
+};
+
+// Allocations made since construction; take() before building any result.
+class AllocationScope {
+public:
+  Allocations take() const {
+    return Allocations{allocation_count.load(std::memory_order_relaxed) - count,
+                       allocation_bytes.load(std::memory_order_relaxed) - bytes};
+  }
+
+private:
+  uint32_t count = allocation_count.load(std::memory_order_relaxed);
+  uint32_t bytes = allocation_bytes.load(std::memory_order_relaxed);
+};
+
+struct Summary {
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t p99;
+  uint32_t max;
+};
+
+Summary summarize(std::vector<uint32_t> &samples) {
+  if (samples.empty()) {
+    return {};
+  }
+  std::sort(samples.begin(), samples.end());
+  auto at = [&](unsigned percent) { return samples[(samples.size() - 1) * percent / 100]; };
+  return Summary{at(50), at(90), at(99), samples.back()};
+}
+
+void report(const char *name, const char *unit, std::vector<uint32_t> &samples,
+            int64_t elapsed_us, const Allocations &allocations) {
+  const std::size_t ops = samples.size();
+  const Summary summary = summarize(samples);
+  const double per_second = elapsed_us > 0 ? ops * 1e6 / elapsed_us : 0.0;
+  std::printf("%-34s %8zu ops %10.0f ops/s  p50 %7" PRIu32 "  p90 %7" PRIu32 "  p99 %7" PRIu32
+              "  max %8" PRIu32 " %-6s  %5.2f allocs/op %7.1f B/op\n",
+              name, ops, per_second, summary.p50, summary.p90, summary.p99, summary.max, unit,
+              ops ? static_cast<double>(allocations.count) / ops : 0.0,
+              ops ? static_cast<double>(allocations.bytes) / ops : 0.0);
+}
+
+// --- Logger::infof under producer contention --------------------------------
+
+constexpr std::size_t log_iterations = CONFIG_BENCH_LOG_ITERATIONS;
+
+struct Producer {
+  std::vector<uint32_t> latencies;
+  SemaphoreHandle_t start;
+  SemaphoreHandle_t done;
+};
+
+void log_producer(void *param) {
+  auto &producer = *static_cast<Producer *>(param);
+  xSemaphoreTake(producer.start, portMAX_DELAY);
+  for (std::size_t i = 0; i < log_iterations; ++i) {
+    const uint32_t begin = cycles();
+    earbrain::logging::Logger::instance().infof(bench_tag, "sample %u value %d",
+                                                static_cast<unsigned>(i), -42);
+    producer.latencies.push_back(cycles() - begin);
+  }
+  xSemaphoreGive(producer.done);
+  vTaskDelete(nullptr);
+}
+
+void bench_log_contention(std::size_t producers) {
+  earbrain::logging::clear();
+  std::vector<Producer> tasks(producers);
+  SemaphoreHandle_t start = xSemaphoreCreateCounting(producers, 0);
+  SemaphoreHandle_t done = xSemaphoreCreateCounting(producers, 0);
+  for (Producer &producer : tasks) {
+    producer.latencies.reserve(log_iterations);
+    producer.start = start;
+    producer.done = done;
+    xTaskCreate(&log_producer, "bench_log", 4096, &producer, CONFIG_BENCH_TASK_PRIORITY,
+                nullptr);
+  }
+
+  const AllocationScope scope;
+  const int64_t begin = now_us();
+  for (std::size_t i = 0; i < producers; ++i) {
+    xSemaphoreGive(start);
+  }
+  for (std::size_t i = 0; i < producers; ++i) {
+    xSemaphoreTake(done, portMAX_DELAY);
+  }
+  const int64_t elapsed = now_us() - begin;
+  earbrain::logging::flush();
+  const Allocations allocations = scope.take();
+
+  std::vector<uint32_t> all;
+  all.reserve(producers * log_iterations);
+  for (Producer &producer : tasks) {
+    all.insert(all.end(), producer.latencies.begin(), producer.latencies.end());
+  }
+  char name[40];
+  std::snprintf(name, sizeof(name), "infof, %zu producer%s", producers,
+                producers == 1 ? "" : "s");
+  report(name, cycle_unit, all, elapsed, allocations);
+
+  vSemaphoreDelete(start);
+  vSemaphoreDelete(done);
+}
+
+// --- LogStore::collect against buffer fill ----------------------------------
+
+void bench_collect(std::size_t fill) {
+  earbrain::logging::clear();
+  for (std::size_t i = 0; i < fill; ++i) {
+    earbrain::logging::infof(bench_tag, "fill %u", static_cast<unsigned>(i));
+  }
+  earbrain::logging::flush();
+
+  constexpr std::size_t rounds = 64;
+  std::vector<uint32_t> tail;
+  std::vector<uint32_t> full;
+  tail.reserve(rounds);
+  full.reserve(rounds);
+
+  const uint64_t newest = earbrain::logging::collect(0, fill).next_cursor;
+  const uint64_t near_end = newest > 16 ? newest - 16 : 0;
+
+  char name[40];
+  {
+    const AllocationScope scope;
+    const int64_t begin = now_us();
+    for (std::size_t i = 0; i < rounds; ++i) {
+      const uint32_t start = cycles();
+      const earbrain::logging::LogBatch batch = earbrain::logging::collect(near_end, 16);
+      tail.push_back(cycles() - start);
+    }
+    const int64_t elapsed = now_us() - begin;
+    const Allocations allocations = scope.take();
+    std::snprintf(name, sizeof(name), "collect last 16, fill %zu", fill);
+    report(name, cycle_unit, tail, elapsed, allocations);
+  }
+  {
+    const AllocationScope scope;
+    const int64_t begin = now_us();
+    for (std::size_t i = 0; i < rounds; ++i) {
+      const uint32_t start = cycles();
+      const earbrain::logging::LogBatch batch = earbrain::logging::collect(0, fill);
+      full.push_back(cycles() - start);
+    }
+    const int64_t elapsed = now_us() - begin;
+    const Allocations allocations = scope.take();
+    std::snprintf(name, sizeof(name), "collect all, fill %zu", fill);
+    report(name, cycle_unit, full, elapsed, allocations);
+  }
+}
+
+// --- run_detached against the task pool --------------------------------------
+
+constexpr std::size_t spawn_iterations = CONFIG_BENCH_SPAWN_ITERATIONS;
+
+void bench_spawn() {
+  earbrain::Completion<int64_t> started;
+  std::vector<uint32_t> latencies;
+  latencies.reserve(spawn_iterations);
+
+  {
+    const AllocationScope scope;
+    const int64_t begin = now_us();
+    for (std::size_t i = 0; i < spawn_iterations; ++i) {
+      const int64_t submitted = now_us();
+      earbrain::tasks::run_detached([&started] { started.complete(now_us()); }, "bench_spawn",
+                                    3072, CONFIG_BENCH_TASK_PRIORITY);
+      latencies.push_back(static_cast<uint32_t>(*started.wait() - submitted));
+      // Let the idle task reclaim the finished task before the next one.
+      vTaskDelay(1);
+    }
+    const int64_t elapsed = now_us() - begin;
+    const Allocations allocations = scope.take();
+    report("run_detached spawn", "us", latencies, elapsed, allocations);
+  }
+
+  earbrain::tasks::TaskPool &pool = earbrain::tasks::pool();
+  latencies.clear();
+  {
+    const AllocationScope scope;
+    const int64_t begin = now_us();
+    for (std::size_t i = 0; i < spawn_iterations; ++i) {
+      const int64_t submitted = now_us();
+      pool.submit([&started] { started.complete(now_us()); }, portMAX_DELAY);
+      latencies.push_back(static_cast<uint32_t>(*started.wait() - submitted));
+    }
+    const int64_t elapsed = now_us() - begin;
+    const Allocations allocations = scope.take();
+    report("pool submit", "us", latencies, elapsed, allocations);
+  }
+}
+
+// --- Completion hand-off -----------------------------------------------------
+
+constexpr std::size_t handoff_iterations = CONFIG_BENCH_HANDOFF_ITERATIONS;
+
+struct PingPong {
+  earbrain::Completion<int64_t> ping;
+  earbrain::Completion<uint32_t> pong;
+};
+
+void handoff_partner(void *param) {
+  auto &pair = *static_cast<PingPong *>(param);
+  for (std::size_t i = 0; i < handoff_iterations; ++i) {
+    const int64_t sent = *pair.ping.wait();
+    pair.pong.complete(static_cast<uint32_t>(now_us() - sent));
+  }
+  vTaskDelete(nullptr);
+}
+
+void bench_handoff() {
+  auto *pair = new PingPong();
+  xTaskCreate(&handoff_partner, "bench_pong", 3072, pair, CONFIG_BENCH_TASK_PRIORITY, nullptr);
+
+  std::vector<uint32_t> latencies;
+  latencies.reserve(handoff_iterations);
+  const AllocationScope scope;
+  const int64_t begin = now_us();
+  for (std::size_t i = 0; i < handoff_iterations; ++i) {
+    pair->ping.complete(now_us());
+    latencies.push_back(*pair->pong.wait());
+  }
+  const int64_t elapsed = now_us() - begin;
+  const Allocations allocations = scope.take();
+  report("Completion hand-off", "us", latencies, elapsed, allocations);
+  // The partner may still be inside complete(); give it time to exit.
+  vTaskDelay(pdMS_TO_TICKS(10));
+  delete pair;
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocation_bytes.fetch_add(static_cast<uint32_t>(size), std::memory_order_relaxed);
+  if (void *memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  std::abort();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocation_bytes.fetch_add(static_cast<uint32_t>(size), std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+
+extern "C" void app_main(void) {
+  // The store still records; only the console is silenced.
+  esp_log_level_set(bench_tag, ESP_LOG_NONE);
+  earbrain::tasks::pool();
+
+  std::printf("\nearbrain benchmarks (%s per op unless noted)\n\n", cycle_unit);
+
+  bench_log_contention(1);
+  bench_log_contention(2);
+  bench_log_contention(CONFIG_BENCH_LOG_PRODUCERS);
+
+  for (std::size_t fill : {64u, 256u, 1024u}) {
+    bench_collect(fill);
+  }
+
+  bench_spawn();
+  bench_handoff();
+
+  if (earbrain::memory_tracking_enabled) {
+    const earbrain::MemorySnapshot memory = earbrain::collect_memory_usage();
+    const char *names[] = {"logging", "wifi", "mdns", "tasks"};
+    std::printf("\nlibrary heap by subsystem\n");
+    for (std::size_t i = 0; i < earbrain::memory_tag_count; ++i) {
+      std::printf("  %-8s live %7" PRIu32 " B  peak %7" PRIu32 " B  %" PRIu32 " allocations\n",
+                  names[i], memory.tags[i].live_bytes, memory.tags[i].peak_bytes,
+                  memory.tags[i].allocations);
+    }
+  }
+
+  std::printf("\ndone\n");
+#if CONFIG_IDF_TARGET_LINUX
+  std::exit(0);
+#endif
+}
@@ -15,6 +15,14 @@ extern "C" void app_main(void) {
 
   earbrain::logging::infof(TAG, "Formatted: %d + %d = %d", 1, 2, 3);
 
+  // Level-gated macros skip argument evaluation when the level is filtered
+  earbrain::logging::level("noisy", ESP_LOG_WARN);
+  EARBRAIN_LOGD("noisy", "Filtered at runtime: %d", 42);
+  EARBRAIN_LOGW("noisy", "Still logged: %d", 42);
+
+  // Deferred records keep the arguments and format them when read back
+  EARBRAIN_LOG_DEFERRED(ESP_LOG_INFO, TAG, "Deferred: %d%%", 75);
+
   auto batch = earbrain::logging::collect(0, 10);
   earbrain::logging::infof(TAG, "Collected %zu log entries", batch.entries.size());
 
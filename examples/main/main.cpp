@@ -187,7 +187,7 @@ static void example_smartconfig() {
   earbrain::wifi().on([](const earbrain::WifiEventData& event) {
     switch (event.event) {
       case earbrain::WifiEvent::ProvisioningCredentialsReceived:
-        if (event.credentials.has_value()) {
+        if (event.credentials) {
           earbrain::logging::infof(TAG, "Received credentials for SSID: %s",
                                    event.credentials->ssid.c_str());
           earbrain::logging::info("Attempting to connect...", TAG);
@@ -60,6 +60,7 @@ extern "C" void app_main(void) {
   mdns_config.service_type = "_http";
   mdns_config.protocol = "_tcp";
   mdns_config.port = 80;
+  mdns_config.txt = {{"path", "/"}};
 
   err = earbrain::mdns().start(mdns_config);
 
@@ -77,6 +78,14 @@ extern "C" void app_main(void) {
     earbrain::logging::info("  - macOS/Linux: dns-sd -B _http._tcp", TAG);
     earbrain::logging::info("  - iOS: Download Discovery - DNS-SD Browser app", TAG);
     earbrain::logging::info("  - Android: Download BonjourBrowser app", TAG);
+
+    // Both keys go out in a single TXT announcement; the host name and
+    // the service itself stay untouched.
+    err = earbrain::mdns().update_txt("_http", "_tcp",
+                                      {{"version", "1.0"}, {"board", "esp32"}});
+    if (err != ESP_OK) {
+      earbrain::logging::errorf(TAG, "Failed to update TXT records: %s", esp_err_to_name(err));
+    }
   } else {
     earbrain::logging::errorf(TAG, "Failed to start mDNS: %s", esp_err_to_name(err));
   }
@@ -33,11 +33,46 @@ extern "C" void app_main(void) {
   auto released = earbrain::collect_metrics();
   earbrain::logging::infof(TAG, "After release: %lu bytes free", released.heap_free);
 
+  // Internal and DMA-capable RAM are what Wi-Fi buffers run out of
+  auto heaps = earbrain::collect_heap_metrics(
+      earbrain::heap_mask(earbrain::HeapKind::Internal) |
+      earbrain::heap_mask(earbrain::HeapKind::Dma));
+  for (auto kind : {earbrain::HeapKind::Internal, earbrain::HeapKind::Dma}) {
+    const auto &heap = heaps[kind];
+    earbrain::logging::infof(TAG, "%s: %lu/%lu free, largest %lu (ratio %.2f)",
+                             kind == earbrain::HeapKind::Internal ? "Internal" : "DMA",
+                             heap.free, heap.total, heap.largest_free_block,
+                             heap.fragmentation_ratio);
+  }
+
+  // Per-task CPU share and stack headroom (needs FreeRTOS run-time stats)
+  static earbrain::TaskSnapshot tasks;
+  if (earbrain::collect_task_metrics(tasks) == ESP_OK) {
+    for (std::size_t i = 0; i < tasks.count; ++i) {
+      const auto &task = tasks.tasks[i];
+      earbrain::logging::infof(TAG, "Task %-16s prio %2lu core %2ld stack free %5lu cpu %5.1f%%",
+                               task.name, task.priority, task.core,
+                               task.stack_high_water, task.cpu_percent);
+    }
+  }
+
+  // Sample in the background and read back per-minute rollups
+  auto &sampler = earbrain::metrics_sampler();
+  if (sampler.start(1000) != ESP_OK) {
+    earbrain::logging::error("Failed to start metrics sampler", TAG);
+  }
+
   earbrain::logging::info("Demo completed. Running idle loop...", TAG);
 
+  uint64_t cursor = 0;
   while (true) {
-    vTaskDelay(pdMS_TO_TICKS(5000));
-    auto metrics = earbrain::collect_metrics();
-    earbrain::logging::infof(TAG, "Heartbeat - Free heap: %lu bytes", metrics.heap_free);
+    vTaskDelay(pdMS_TO_TICKS(60000));
+    auto batch = sampler.collect(earbrain::MetricsResolution::Minute, cursor, 10);
+    for (const auto &rollup : batch.samples) {
+      earbrain::logging::infof(TAG, "Minute @%lus - free min/avg/max: %lu/%lu/%lu bytes",
+                               rollup.start_s, rollup.heap_free.min,
+                               rollup.heap_free.avg, rollup.heap_free.max);
+    }
+    cursor = batch.next_cursor;
   }
 }
@@ -1,12 +1,32 @@
 #include "earbrain/logging.hpp"
 #include "earbrain/metrics.hpp"
+#include "earbrain/scheduler.hpp"
 #include "earbrain/task_helpers.hpp"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <atomic>
+#include <cmath>
 
 static const char *TAG = "tasks_example";
 
+static constexpr int frame_count = 64;
+static constexpr int frame_size = 256;
+static float frames[frame_count][frame_size];
+static float energy[frame_count];
+
+// Always-on task: TCB and stack are reserved at link time.
+static earbrain::tasks::StaticTask<3072> heartbeat_task;
+
+static void process_frame(int index) {
+  float sum = 0.0f;
+  for (int i = 0; i < frame_size; ++i) {
+    const float sample = std::sin(frames[index][i]) * 0.5f;
+    sum += sample * sample;
+  }
+  energy[index] = sum;
+}
+
 extern "C" void app_main(void) {
   earbrain::logging::info("=== Task Helpers Demo ===", TAG);
 
@@ -20,25 +40,49 @@ extern "C" void app_main(void) {
 
   vTaskDelay(pdMS_TO_TICKS(1000));
 
-  earbrain::logging::info("Creating 3 parallel tasks...", TAG);
+  earbrain::logging::info("Spawning 3 parallel jobs...", TAG);
+  auto &scheduler = earbrain::tasks::scheduler();
+  earbrain::tasks::JoinHandle join;
   for (int i = 0; i < 3; i++) {
-    earbrain::tasks::run_detached([i]() {
+    scheduler.spawn(join, [i]() {
       int count = counter.fetch_add(1);
       char task_name[32];
       snprintf(task_name, sizeof(task_name), "parallel_%d", i);
       earbrain::logging::infof(task_name, "Counter: %d", count);
       vTaskDelay(pdMS_TO_TICKS(300));
-    }, "parallel_task");
+    }, i % portNUM_PROCESSORS);
   }
 
-  vTaskDelay(pdMS_TO_TICKS(1500));
+  // Returns as soon as the last job has run, no guessing at a delay.
+  scheduler.join(join);
   earbrain::logging::infof(TAG, "Final counter: %d", counter.load());
 
-  earbrain::logging::info("Demo completed. Running idle loop...", TAG);
+  for (int f = 0; f < frame_count; ++f) {
+    for (int i = 0; i < frame_size; ++i) {
+      frames[f][i] = static_cast<float>(f * frame_size + i) * 0.001f;
+    }
+  }
 
-  while (true) {
-    vTaskDelay(pdMS_TO_TICKS(5000));
-    auto metrics = earbrain::collect_metrics();
-    earbrain::logging::infof(TAG, "Heartbeat - Free heap: %lu bytes", metrics.heap_free);
+  int64_t started = esp_timer_get_time();
+  for (int f = 0; f < frame_count; ++f) {
+    process_frame(f);
   }
+  const int64_t serial_us = esp_timer_get_time() - started;
+
+  started = esp_timer_get_time();
+  earbrain::tasks::parallel_for(0, frame_count, 4, process_frame);
+  const int64_t parallel_us = esp_timer_get_time() - started;
+
+  earbrain::logging::infof(TAG, "%d frames: serial %lld us, parallel_for %lld us",
+                           frame_count, serial_us, parallel_us);
+
+  earbrain::logging::info("Demo completed. Starting static heartbeat task...", TAG);
+
+  heartbeat_task.start([]() {
+    while (true) {
+      vTaskDelay(pdMS_TO_TICKS(5000));
+      auto metrics = earbrain::collect_metrics();
+      earbrain::logging::infof(TAG, "Heartbeat - Free heap: %lu bytes", metrics.heap_free);
+    }
+  }, "heartbeat", 5, 0);
 }
@@ -3,6 +3,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "lwip/ip4_addr.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include <cstring>
 
@@ -75,6 +76,35 @@ extern "C" void app_main(void) {
     earbrain::logging::errorf(TAG, "Scan failed: %s", esp_err_to_name(scan_result.error));
   }
 
+  // A repeat within CONFIG_EARBRAIN_WIFI_SCAN_CACHE_TTL_MS stays off air.
+  int64_t started = esp_timer_get_time();
+  auto cached_result = earbrain::wifi().perform_scan();
+  earbrain::logging::infof(TAG, "Repeat scan: %zu networks in %lld us (cached)",
+                           cached_result.networks.size(), esp_timer_get_time() - started);
+
+  // Same sweep without blocking: records land in a static buffer and are
+  // reported channel by channel as the radio moves on.
+  static wifi_ap_record_t records[32];
+  earbrain::logging::info("Starting per-channel async scan...", TAG);
+  earbrain::WifiScanOptions options;
+  options.per_channel = true;
+  earbrain::wifi()
+      .scan_async(records,
+                  [](const earbrain::WifiScanChunk &chunk) {
+                    earbrain::logging::infof(TAG, "  Ch %d: %zu networks", chunk.channel,
+                                             chunk.records.size());
+                  },
+                  options)
+      .then([](earbrain::WifiScanOutcome outcome) {
+        if (outcome.error != ESP_OK) {
+          earbrain::logging::errorf(TAG, "Async scan failed: %s", esp_err_to_name(outcome.error));
+        } else {
+          earbrain::logging::infof(TAG, "Async scan found %d records%s", outcome.count,
+                                   outcome.truncated ? " (buffer full)" : "");
+        }
+        return outcome.error;
+      });
+
   earbrain::logging::info("Scan complete. Going to idle loop...", TAG);
 
   // Idle loop to keep app running
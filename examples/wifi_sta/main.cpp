@@ -1,9 +1,13 @@
 #include "earbrain/logging.hpp"
+#include "earbrain/mdns_service.hpp"
 #include "earbrain/metrics.hpp"
+#include "earbrain/trace.hpp"
 #include "earbrain/wifi_service.hpp"
+#include "earbrain/wifi_telemetry.hpp"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "sdkconfig.h"
+#include <cstdio>
 #include <cstring>
 
 // Try to include credentials.h if it exists, otherwise fall back to sdkconfig
@@ -30,6 +34,11 @@ extern "C" void app_main(void) {
           earbrain::logging::infof(TAG, "Connected! IP Address: %s",
                                    earbrain::ip_to_string(event.ip_address.value()).c_str());
         }
+        if (event.time_to_ip_ms.has_value()) {
+          earbrain::logging::infof(TAG, "Time to IP: %lu ms%s",
+                                   static_cast<unsigned long>(*event.time_to_ip_ms),
+                                   event.fast_connect ? " (fast reconnect)" : "");
+        }
         break;
 
       case earbrain::WifiEvent::Disconnected:
@@ -37,6 +46,10 @@ extern "C" void app_main(void) {
           earbrain::logging::warnf(TAG, "Disconnected (reason=%d)",
                                    static_cast<int>(event.disconnect_reason.value()));
         }
+        if (auto next = earbrain::wifi().status().next_reconnect_ms) {
+          earbrain::logging::infof(TAG, "Next reconnect attempt in %lu ms",
+                                   static_cast<unsigned long>(*next));
+        }
         break;
 
       case earbrain::WifiEvent::ConnectionFailed:
@@ -57,18 +70,50 @@ extern "C" void app_main(void) {
     earbrain::logging::errorf(TAG, "Failed to save credentials: %s", esp_err_to_name(save_err));
   }
 #endif
+  // A second site; connect() picks whichever known network is in range.
+#if defined(WIFI_SSID_2) && defined(WIFI_PASSWORD_2)
+  earbrain::wifi().save_credentials(WIFI_SSID_2, WIFI_PASSWORD_2, 1);
+#endif
+  for (const auto &network : earbrain::wifi().known_networks().networks()) {
+    earbrain::logging::infof(TAG, "Known network: %s (priority %u)", network.ssid.c_str(),
+                             static_cast<unsigned>(network.priority));
+  }
+
+  // Advertise while the station is online; short drops keep the responder.
+  earbrain::MdnsConfig mdns_config;
+  mdns_config.hostname = "esp-sta-device";
+  mdns_config.instance_name = "ESP STA Demo";
+  earbrain::mdns().attach(earbrain::wifi(), mdns_config);
 
   // Start STA mode (will auto-connect if credentials are saved)
   earbrain::wifi().mode(earbrain::WifiMode::STA);
 
-  vTaskDelay(pdMS_TO_TICKS(2000));
+  // Report once the connection settles; no task waits in the meantime.
+  earbrain::wifi()
+      .connect_async()
+      .then([]() {
+        auto status = earbrain::wifi().status();
+        const char *mode_str = (status.mode == earbrain::WifiMode::STA)     ? "STA"
+                               : (status.mode == earbrain::WifiMode::APSTA) ? "APSTA"
+                                                                            : "Off";
+        earbrain::logging::infof(TAG, "WiFi Mode: %s", mode_str);
+        earbrain::logging::infof(TAG, "Station IP: %s",
+                                 earbrain::ip_to_string(status.sta_ip).c_str());
+        return ESP_OK;
+      })
+      .then([](esp_err_t result) {
+        if (result != ESP_OK) {
+          earbrain::logging::errorf(TAG, "Connection did not complete: %s",
+                                    esp_err_to_name(result));
+        } else if constexpr (earbrain::trace::enabled) {
+          // Paste into ui.perfetto.dev to see where the connect went.
+          const auto spans = earbrain::trace::collect(0, 256);
+          std::printf("%s\n", earbrain::trace::to_chrome_json(spans).c_str());
+        }
+        return result;
+      });
 
-  auto status = earbrain::wifi().status();
-  const char* mode_str = (status.mode == earbrain::WifiMode::STA) ? "STA" :
-                         (status.mode == earbrain::WifiMode::APSTA) ? "APSTA" : "Off";
-  earbrain::logging::infof(TAG, "WiFi Mode: %s", mode_str);
-  earbrain::logging::infof(TAG, "Connected: %s", status.sta_connected ? "Yes" : "No");
-  earbrain::logging::infof(TAG, "Connecting: %s", status.sta_connecting ? "Yes" : "No");
+  earbrain::wifi_telemetry().start();
 
   earbrain::logging::info("", TAG);
   earbrain::logging::info("Running idle loop...", TAG);
@@ -77,5 +122,11 @@ extern "C" void app_main(void) {
     vTaskDelay(pdMS_TO_TICKS(5000));
     auto metrics = earbrain::collect_metrics();
     earbrain::logging::infof(TAG, "Heartbeat - Free heap: %lu bytes", metrics.heap_free);
+    if (auto link = earbrain::wifi_telemetry().latest(); link && link->associated) {
+      earbrain::logging::infof(TAG, "Link - RSSI: %d dBm, channel %u, rx %lu B/s, tx %lu B/s",
+                               link->rssi, static_cast<unsigned>(link->channel),
+                               static_cast<unsigned long>(link->rx_bytes_per_s),
+                               static_cast<unsigned long>(link->tx_bytes_per_s));
+    }
   }
 }
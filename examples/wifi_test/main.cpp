@@ -293,7 +293,7 @@ extern "C" void app_main(void) {
         break;
 
       case earbrain::WifiEvent::ProvisioningCredentialsReceived:
-        if (event.credentials.has_value()) {
+        if (event.credentials) {
           earbrain::logging::infof(TAG, "  SSID: %s",
                                   event.credentials->ssid.c_str());
         }
@@ -355,10 +355,16 @@ extern "C" void app_main(void) {
 
   earbrain::logging::info("Running idle loop...", TAG);
 
+  uint32_t seen_generation = earbrain::wifi().status_generation();
   while (true) {
     vTaskDelay(pdMS_TO_TICKS(10000));
     auto metrics = earbrain::collect_metrics();
     earbrain::logging::infof(TAG, "Heartbeat - Free heap: %lu bytes, Events: %d",
                             metrics.heap_free, event_count);
+    // Only re-read and print the status when something changed.
+    if (earbrain::wifi().status_generation() != seen_generation) {
+      seen_generation = earbrain::wifi().status().generation;
+      log_current_status();
+    }
   }
 }
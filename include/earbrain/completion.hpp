@@ -1,20 +1,72 @@
 #pragma once
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
 
+#include <atomic>
+#include <cstdint>
+#include <new>
 #include <optional>
+#include <utility>
 
 namespace earbrain {
 
+namespace detail {
+
+constexpr UBaseType_t completion_notify_index = CONFIG_EARBRAIN_COMPLETION_NOTIFY_INDEX;
+constexpr uint32_t completion_notify_bit = 1u << 31;
+
+// Index 0 belongs to ulTaskNotifyTake(), stream buffers and the library's
+// own task loops; a completion bit landing there corrupts their counts.
+static_assert(completion_notify_index > 0,
+              "CONFIG_EARBRAIN_COMPLETION_NOTIFY_INDEX must not be 0");
+static_assert(completion_notify_index < configTASK_NOTIFICATION_ARRAY_ENTRIES,
+              "CONFIG_EARBRAIN_COMPLETION_NOTIFY_INDEX needs more "
+              "FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES");
+
+inline TickType_t completion_ticks(uint32_t timeout_ms) {
+  return (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
+
+// Holds at most one T in place; the owning completion tracks whether it is
+// constructed.
+template <typename T>
+class CompletionSlot {
+public:
+  template <typename... Args>
+  void construct(Args &&...args) {
+    ::new (static_cast<void *>(storage)) T(std::forward<Args>(args)...);
+  }
+  T &get() noexcept { return *std::launder(reinterpret_cast<T *>(storage)); }
+  const T &get() const noexcept {
+    return *std::launder(reinterpret_cast<const T *>(storage));
+  }
+  void destroy() noexcept { get().~T(); }
+
+private:
+  alignas(T) unsigned char storage[sizeof(T)];
+};
+
+} // namespace detail
+
+// Result handed from producers to a single waiting task. The waiter sleeps on
+// a direct-to-task notification (CONFIG_EARBRAIN_COMPLETION_NOTIFY_INDEX), so
+// no kernel object is allocated. The result is moved into inline storage and
+// moved out by wait(), which leaves the completion empty and ready for reuse.
+// A result completed before the last one was taken replaces it. Unlike the
+// old semaphore-based version only one task can wait at a time; use
+// BroadcastCompletion when several tasks need the result.
 template <typename T>
 class Completion {
 public:
-  Completion() : semaphore(xSemaphoreCreateBinary()), result{} {}
+  Completion() = default;
 
   ~Completion() {
-    if (semaphore) {
-      vSemaphoreDelete(semaphore);
+    wait_for_notifier();
+    if (state.load() == State::Ready) {
+      slot.destroy();
     }
   }
 
@@ -23,39 +75,173 @@ public:
   Completion(Completion &&) = delete;
   Completion &operator=(Completion &&) = delete;
 
-  void complete(T value) {
-    result = value;
-    if (semaphore) {
-      xSemaphoreGive(semaphore);
+  // Replaces a result no waiter has taken yet and returns false in that case.
+  template <typename... Args>
+  bool emplace(Args &&...args) {
+    // Raised before the result is visible so that a task seeing Ready
+    // cannot destroy the completion while we still touch it.
+    notifiers.fetch_add(1);
+    State current = state.load();
+    while (!((current == State::Empty || current == State::Ready) &&
+             state.compare_exchange_weak(current, State::Writing))) {
+      // Another producer or the waiter is moving a result; it is quick.
+      if (current == State::Writing || current == State::Taking) {
+        vTaskDelay(1);
+        current = state.load();
+      }
+    }
+    const bool replaced = current == State::Ready;
+    if (replaced) {
+      slot.destroy();
+    }
+    slot.construct(std::forward<Args>(args)...);
+    state.store(State::Ready);
+
+    if (TaskHandle_t task = waiter.exchange(nullptr)) {
+      xTaskNotifyIndexed(task, detail::completion_notify_index,
+                         detail::completion_notify_bit, eSetBits);
     }
+    notifiers.fetch_sub(1);
+    return !replaced;
   }
 
+  bool complete(T &&value) { return emplace(std::move(value)); }
+  bool complete(const T &value) { return emplace(value); }
+
+  // Returns std::nullopt on timeout. Only one task may wait at a time; a
+  // second one gets std::nullopt straight away instead of queueing.
   std::optional<T> wait(uint32_t timeout_ms = portMAX_DELAY) {
-    if (!semaphore) {
-      return std::nullopt;
+    if (state.load() != State::Ready) {
+      TaskHandle_t expected = nullptr;
+      if (!waiter.compare_exchange_strong(expected, xTaskGetCurrentTaskHandle())) {
+        return std::nullopt;
+      }
+      block(detail::completion_ticks(timeout_ms));
+    }
+
+    // A producer replacing the result holds it in Writing for a moment.
+    State expected = State::Ready;
+    while (!state.compare_exchange_weak(expected, State::Taking)) {
+      if (expected != State::Writing && expected != State::Ready) {
+        return std::nullopt;
+      }
+      if (expected == State::Writing) {
+        vTaskDelay(1);
+      }
+      expected = State::Ready;
+    }
+    std::optional<T> result(std::move(slot.get()));
+    slot.destroy();
+    state.store(State::Empty);
+    return result;
+  }
+
+  // A result is stored and has not been taken by wait() yet.
+  bool is_complete() const { return state.load() == State::Ready; }
+
+private:
+  enum class State : uint8_t { Empty, Writing, Ready, Taking };
+
+  void block(TickType_t ticks) {
+    const TickType_t start = xTaskGetTickCount();
+    while (state.load() != State::Ready) {
+      TickType_t remaining = portMAX_DELAY;
+      if (ticks != portMAX_DELAY) {
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= ticks) {
+          break;
+        }
+        remaining = ticks - elapsed;
+      }
+      // Wake-ups from other users of the same index just loop again.
+      xTaskNotifyWaitIndexed(detail::completion_notify_index, 0,
+                             detail::completion_notify_bit, nullptr, remaining);
     }
 
-    TickType_t ticks = (timeout_ms == portMAX_DELAY)
-                       ? portMAX_DELAY
-                       : pdMS_TO_TICKS(timeout_ms);
+    // When emplace() has already claimed us, its notification may still be
+    // in flight; let it land so it cannot wake a later, unrelated wait.
+    if (waiter.exchange(nullptr) == nullptr) {
+      wait_for_notifier();
+      ulTaskNotifyValueClearIndexed(nullptr, detail::completion_notify_index,
+                                    detail::completion_notify_bit);
+    }
+  }
 
-    if (xSemaphoreTake(semaphore, ticks) == pdTRUE) {
-      return result;
+  void wait_for_notifier() const {
+    while (notifiers.load() > 0) {
+      vTaskDelay(1);
     }
+  }
+
+  std::atomic<State> state{State::Empty};
+  std::atomic<TaskHandle_t> waiter{nullptr};
+  std::atomic<uint8_t> notifiers{0};
+  detail::CompletionSlot<T> slot;
+};
+
+// Result that any number of tasks can wait for. The waiters block on a
+// statically allocated event group; the result stays in place until
+// reset(), and wait() hands out a pointer to it.
+template <typename T>
+class BroadcastCompletion {
+public:
+  BroadcastCompletion() : group(xEventGroupCreateStatic(&group_storage)) {}
 
-    return std::nullopt;
+  ~BroadcastCompletion() {
+    if (state.load() == State::Ready) {
+      slot.destroy();
+    }
+    vEventGroupDelete(group);
   }
 
-  bool is_complete() const {
-    if (!semaphore) {
+  BroadcastCompletion(const BroadcastCompletion &) = delete;
+  BroadcastCompletion &operator=(const BroadcastCompletion &) = delete;
+  BroadcastCompletion(BroadcastCompletion &&) = delete;
+  BroadcastCompletion &operator=(BroadcastCompletion &&) = delete;
+
+  template <typename... Args>
+  bool emplace(Args &&...args) {
+    State expected = State::Empty;
+    if (!state.compare_exchange_strong(expected, State::Writing)) {
       return false;
     }
-    return uxSemaphoreGetCount(semaphore) > 0;
+    slot.construct(std::forward<Args>(args)...);
+    state.store(State::Ready);
+    xEventGroupSetBits(group, ready_bit);
+    return true;
+  }
+
+  bool complete(T &&value) { return emplace(std::move(value)); }
+  bool complete(const T &value) { return emplace(value); }
+
+  // nullptr on timeout. The pointer stays valid until reset().
+  const T *wait(uint32_t timeout_ms = portMAX_DELAY) const {
+    const EventBits_t bits = xEventGroupWaitBits(
+        group, ready_bit, pdFALSE, pdTRUE, detail::completion_ticks(timeout_ms));
+    return (bits & ready_bit) ? &slot.get() : nullptr;
+  }
+
+  bool is_complete() const { return state.load() == State::Ready; }
+
+  // Drops the result. No task may be waiting or still using it.
+  void reset() {
+    xEventGroupClearBits(group, ready_bit);
+    State expected = State::Ready;
+    if (state.compare_exchange_strong(expected, State::Writing)) {
+      slot.destroy();
+      state.store(State::Empty);
+    }
   }
 
 private:
-  SemaphoreHandle_t semaphore;
-  T result;
+  enum class State : uint8_t { Empty, Writing, Ready };
+
+  static constexpr EventBits_t ready_bit = 1u << 0;
+
+  StaticEventGroup_t group_storage;
+  EventGroupHandle_t group;
+  std::atomic<State> state{State::Empty};
+  detail::CompletionSlot<T> slot;
 };
 
-} // namespace earbrain
\ No newline at end of file
+} // namespace earbrain
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "earbrain/completion.hpp"
+#include "earbrain/inline_function.hpp"
+#include "earbrain/task_pool.hpp"
+#include "esp_err.h"
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace earbrain {
+
+template <typename T>
+class Future;
+template <typename T>
+class Promise;
+
+namespace detail {
+
+template <typename T>
+struct is_future : std::false_type {};
+template <typename T>
+struct is_future<Future<T>> : std::true_type {};
+
+template <typename T>
+struct future_value {
+  using type = T;
+};
+template <typename T>
+struct future_value<Future<T>> {
+  using type = T;
+};
+
+// A continuation takes the value, or nothing when the value is an esp_err_t;
+// in that case it only runs on ESP_OK and errors skip straight down the
+// chain.
+template <typename T, typename F>
+constexpr bool takes_value = std::is_invocable_v<F &, T &&>;
+
+template <typename T, typename F>
+struct then_result {
+  using type = std::invoke_result_t<F &, T &&>;
+};
+template <typename F>
+struct then_result<esp_err_t, F> {
+  using type = typename std::conditional_t<takes_value<esp_err_t, F>,
+                                           std::invoke_result<F &, esp_err_t &&>,
+                                           std::invoke_result<F &>>::type;
+};
+
+enum class Dispatch : uint8_t { Pool, Inline };
+
+// Shared between one Promise and one Future; freed with the last of them
+// or of the jobs running its continuation.
+template <typename T>
+class FutureState {
+public:
+  using Continuation = InlineFunction<void(T &&), 32>;
+
+  void retain() { refs.fetch_add(1, std::memory_order_relaxed); }
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  bool set(T &&result) {
+    Completion<T> *target = nullptr;
+    bool dispatch_now = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (fulfilled) {
+        return false;
+      }
+      fulfilled = true;
+      if (continuation) {
+        value.emplace(std::move(result));
+        dispatch_now = true;
+      } else if (waiter) {
+        target = std::exchange(waiter, nullptr);
+      } else {
+        value.emplace(std::move(result));
+      }
+    }
+    if (target) {
+      target->complete(std::move(result));
+    } else if (dispatch_now) {
+      dispatch();
+    }
+    return true;
+  }
+
+  void on_ready(Continuation next, Dispatch how) {
+    bool dispatch_now = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      continuation = std::move(next);
+      mode = how;
+      dispatch_now = value.has_value();
+    }
+    if (dispatch_now) {
+      dispatch();
+    }
+  }
+
+  std::optional<T> take(uint32_t timeout_ms) {
+    Completion<T> completion;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (value) {
+        std::optional<T> result(std::move(value));
+        value.reset();
+        return result;
+      }
+      if (continuation || waiter) {
+        return std::nullopt;
+      }
+      waiter = &completion;
+    }
+
+    auto result = completion.wait(timeout_ms);
+    if (!result) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (waiter == &completion) {
+        waiter = nullptr;
+        return std::nullopt;
+      }
+    }
+    // set() picked us up just as we timed out; the value is on its way.
+    return result ? std::move(result) : completion.wait();
+  }
+
+  bool ready() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return value.has_value();
+  }
+
+private:
+  ~FutureState() = default;
+
+  void dispatch() {
+    retain();
+    if (mode == Dispatch::Pool &&
+        tasks::pool().submit([this]() {
+          run();
+          release();
+        }) == ESP_OK) {
+      return;
+    }
+    // Inline by request, or the pool is stopped or full.
+    run();
+    release();
+  }
+
+  void run() {
+    Continuation next;
+    std::optional<T> result;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      next = std::move(continuation);
+      result = std::move(value);
+      value.reset();
+    }
+    if (next && result) {
+      next(std::move(*result));
+    }
+  }
+
+  std::mutex mutex;
+  std::optional<T> value;
+  Continuation continuation;
+  Completion<T> *waiter = nullptr;
+  Dispatch mode = Dispatch::Pool;
+  bool fulfilled = false;
+  std::atomic<uint8_t> refs{1};
+};
+
+} // namespace detail
+
+// Producer side of a Future. Each Promise is fulfilled at most once; one
+// dropped unfulfilled leaves its Future pending forever.
+template <typename T>
+class Promise {
+public:
+  static_assert(!std::is_void_v<T>, "Promise needs a result type");
+
+  Promise() : state(new detail::FutureState<T>()) {}
+  ~Promise() {
+    if (state) {
+      state->release();
+    }
+  }
+
+  Promise(Promise &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+  Promise &operator=(Promise &&other) noexcept {
+    if (this != &other) {
+      if (state) {
+        state->release();
+      }
+      state = std::exchange(other.state, nullptr);
+    }
+    return *this;
+  }
+
+  Promise(const Promise &) = delete;
+  Promise &operator=(const Promise &) = delete;
+
+  // The Future for this promise; call once.
+  Future<T> future() {
+    state->retain();
+    return Future<T>(state);
+  }
+
+  bool set(T value) { return state && state->set(std::move(value)); }
+
+private:
+  detail::FutureState<T> *state;
+};
+
+// Result that arrives later. then() attaches a continuation that runs on
+// the task pool once the value is set, so a chain of asynchronous steps
+// holds no task while it waits. A continuation may itself return a Future,
+// which is awaited before the next step runs.
+template <typename T>
+class Future {
+public:
+  Future() = default;
+  ~Future() {
+    if (state) {
+      state->release();
+    }
+  }
+
+  Future(Future &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+  Future &operator=(Future &&other) noexcept {
+    if (this != &other) {
+      if (state) {
+        state->release();
+      }
+      state = std::exchange(other.state, nullptr);
+    }
+    return *this;
+  }
+
+  Future(const Future &) = delete;
+  Future &operator=(const Future &) = delete;
+
+  bool valid() const noexcept { return state != nullptr; }
+  bool ready() const { return state && state->ready(); }
+
+  // Blocks the calling task. Returns std::nullopt on timeout, or when a
+  // continuation is already attached.
+  std::optional<T> get(uint32_t timeout_ms = portMAX_DELAY) {
+    return state ? state->take(timeout_ms) : std::nullopt;
+  }
+
+  template <typename F,
+            typename R = typename detail::then_result<T, std::decay_t<F>>::type,
+            typename U = typename detail::future_value<R>::type>
+  Future<U> then(F &&func) && {
+    static_assert(!std::is_void_v<R>, "continuations must return a value");
+    static_assert(!std::is_same_v<T, esp_err_t> ||
+                      detail::takes_value<T, std::decay_t<F>> ||
+                      std::is_same_v<U, esp_err_t>,
+                  "a step that skips on error must yield an esp_err_t");
+
+    Promise<U> promise;
+    Future<U> next = promise.future();
+    attach(
+        [func = std::forward<F>(func), promise = std::move(promise)](T &&value) mutable {
+          using Fn = std::decay_t<F>;
+          if constexpr (std::is_same_v<T, esp_err_t> && !detail::takes_value<T, Fn>) {
+            if (value != ESP_OK) {
+              promise.set(value);
+              return;
+            }
+            resolve(promise, func());
+          } else {
+            resolve(promise, func(std::move(value)));
+          }
+        },
+        detail::Dispatch::Pool);
+    return next;
+  }
+
+private:
+  friend class Promise<T>;
+  template <typename>
+  friend class Future;
+
+  explicit Future(detail::FutureState<T> *state) : state(state) {}
+
+  template <typename F>
+  void attach(F &&func, detail::Dispatch how) {
+    if (state) {
+      detail::FutureState<T> *current = std::exchange(state, nullptr);
+      current->on_ready(typename detail::FutureState<T>::Continuation(
+                            std::forward<F>(func)),
+                        how);
+      current->release();
+    }
+  }
+
+  template <typename U, typename R>
+  static void resolve(Promise<U> &promise, R &&result) {
+    if constexpr (detail::is_future<std::decay_t<R>>::value) {
+      // Already on a pool worker; no need to hop again.
+      std::move(result).attach(
+          [promise = std::move(promise)](U &&value) mutable {
+            promise.set(std::move(value));
+          },
+          detail::Dispatch::Inline);
+    } else {
+      promise.set(std::forward<R>(result));
+    }
+  }
+
+  detail::FutureState<T> *state = nullptr;
+};
+
+// Future that is already fulfilled, for early returns from async APIs.
+template <typename T>
+Future<T> make_ready_future(T value) {
+  Promise<T> promise;
+  Future<T> future = promise.future();
+  promise.set(std::move(value));
+  return future;
+}
+
+} // namespace earbrain
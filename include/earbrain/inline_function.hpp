@@ -0,0 +1,132 @@
+#pragma once
+
+#include "earbrain/memory_tracking.hpp"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace earbrain {
+
+template <typename Signature, std::size_t Capacity = 32>
+class InlineFunction;
+
+// Move-only callable with small-buffer storage. Callables up to `Capacity`
+// bytes (most lambdas capturing a few pointers) live inside the object;
+// larger ones fall back to a single heap allocation, charged to
+// MemoryTag::Tasks.
+template <typename R, typename... Args, std::size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+public:
+  InlineFunction() noexcept = default;
+  InlineFunction(std::nullptr_t) noexcept {}
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<F>, InlineFunction> &&
+                std::is_invocable_r_v<R, std::decay_t<F> &, Args...>>>
+  InlineFunction(F &&func) {
+    using Fn = std::decay_t<F>;
+    if constexpr (stored_inline<Fn>) {
+      ::new (static_cast<void *>(storage)) Fn(std::forward<F>(func));
+      ops = &inline_ops<Fn>;
+    } else {
+      ::new (static_cast<void *>(storage))
+          Fn *(tracked_new<Fn>(MemoryTag::Tasks, std::forward<F>(func)));
+      ops = &heap_ops<Fn>;
+    }
+  }
+
+  InlineFunction(InlineFunction &&other) noexcept { take(other); }
+
+  InlineFunction &operator=(InlineFunction &&other) noexcept {
+    if (this != &other) {
+      reset();
+      take(other);
+    }
+    return *this;
+  }
+
+  InlineFunction &operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  InlineFunction(const InlineFunction &) = delete;
+  InlineFunction &operator=(const InlineFunction &) = delete;
+
+  ~InlineFunction() { reset(); }
+
+  explicit operator bool() const noexcept { return ops != nullptr; }
+
+  R operator()(Args... args) {
+    return ops->invoke(storage, std::forward<Args>(args)...);
+  }
+
+  // Whether `F` is stored without a heap allocation.
+  template <typename F>
+  static constexpr bool fits_inline() {
+    return stored_inline<std::decay_t<F>>;
+  }
+
+private:
+  struct Ops {
+    R (*invoke)(void *storage, Args &&...args);
+    void (*move)(void *destination, void *source) noexcept;
+    void (*destroy)(void *storage) noexcept;
+  };
+
+  template <typename Fn>
+  static constexpr bool stored_inline =
+      sizeof(Fn) <= Capacity && alignof(Fn) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<Fn>;
+
+  template <typename Fn>
+  static constexpr Ops inline_ops = {
+      [](void *storage, Args &&...args) -> R {
+        return (*static_cast<Fn *>(storage))(std::forward<Args>(args)...);
+      },
+      [](void *destination, void *source) noexcept {
+        Fn *from = static_cast<Fn *>(source);
+        ::new (destination) Fn(std::move(*from));
+        from->~Fn();
+      },
+      [](void *storage) noexcept { static_cast<Fn *>(storage)->~Fn(); },
+  };
+
+  template <typename Fn>
+  static constexpr Ops heap_ops = {
+      [](void *storage, Args &&...args) -> R {
+        return (**static_cast<Fn **>(storage))(std::forward<Args>(args)...);
+      },
+      [](void *destination, void *source) noexcept {
+        ::new (destination) Fn *(*static_cast<Fn **>(source));
+      },
+      [](void *storage) noexcept {
+        tracked_delete(MemoryTag::Tasks, *static_cast<Fn **>(storage));
+      },
+  };
+
+  void take(InlineFunction &other) noexcept {
+    if (other.ops) {
+      other.ops->move(storage, other.storage);
+      ops = other.ops;
+      other.ops = nullptr;
+    }
+  }
+
+  void reset() noexcept {
+    if (ops) {
+      ops->destroy(storage);
+      ops = nullptr;
+    }
+  }
+
+  static_assert(Capacity >= sizeof(void *), "InlineFunction needs room for a pointer");
+
+  alignas(std::max_align_t) unsigned char storage[Capacity];
+  const Ops *ops = nullptr;
+};
+
+} // namespace earbrain
@@ -1,15 +1,36 @@
 #pragma once
 
+#include "earbrain/memory_tracking.hpp"
+#include "esp_err.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
 
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <deque>
 #include <mutex>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace earbrain::logging {
 
+// Least severe level that is compiled in (CONFIG_EARBRAIN_LOG_MIN_LEVEL).
+// Calls below it made through the EARBRAIN_LOG* macros compile to nothing.
+inline constexpr esp_log_level_t compiled_level =
+    static_cast<esp_log_level_t>(CONFIG_EARBRAIN_LOG_MIN_LEVEL);
+
+constexpr bool level_compiled_in(esp_log_level_t level) {
+  return level != ESP_LOG_NONE && level <= compiled_level;
+}
+
 struct LogEntry {
   uint64_t id = 0;
   uint32_t timestamp_ms = 0;
@@ -18,25 +39,209 @@ struct LogEntry {
   std::string message;
 };
 
+// What an asynchronous producer does when the queue is full.
+enum class OverflowPolicy {
+  DropNewest,
+  DropOldest,
+  Block
+};
+
 struct LogBatch {
   std::vector<LogEntry> entries;
   uint64_t next_cursor = 0;
   bool has_more = false;
 };
 
+// Borrowed view of a stored entry; only valid inside a for_each_since visitor,
+// and a deferred record's message only until the visitor returns.
+struct LogView {
+  uint64_t id = 0;
+  uint32_t timestamp_ms = 0;
+  esp_log_level_t level = ESP_LOG_INFO;
+  std::string_view tag;
+  std::string_view message;
+};
+
+struct LogVisitResult {
+  std::size_t visited = 0;
+  uint64_t next_cursor = 0;
+  bool has_more = false;
+};
+
+// Format string and raw arguments captured by Logger::deferred(). The text is
+// produced only when the record is printed or read back.
+struct DeferredRecord {
+  using FormatFn = int (*)(char *buffer, std::size_t size, const char *format,
+                           const uint8_t *args);
+
+  static constexpr std::size_t args_capacity = 24;
+
+  FormatFn format_fn = nullptr;
+  const char *format = nullptr;
+  uint8_t args_size = 0;
+  uint8_t args[args_capacity] = {};
+
+  int render(char *buffer, std::size_t size) const {
+    return format_fn ? format_fn(buffer, size, format, args) : -1;
+  }
+};
+
+namespace detail {
+
+template <typename T>
+T unpack_arg(const uint8_t *&cursor) {
+  T value;
+  std::memcpy(&value, cursor, sizeof(T));
+  cursor += sizeof(T);
+  return value;
+}
+
+template <typename... Args>
+int format_packed(char *buffer, std::size_t size, const char *format,
+                  const uint8_t *args) {
+  // Braced initialisation unpacks the arguments strictly left to right.
+  const std::tuple<Args...> values{unpack_arg<Args>(args)...};
+  return std::apply(
+      [&](auto... unpacked) { return snprintf(buffer, size, format, unpacked...); },
+      values);
+}
+
+template <typename... Args>
+DeferredRecord make_deferred(const char *format, Args... args) {
+  static_assert(((std::is_arithmetic_v<Args> || std::is_pointer_v<Args>) && ...),
+                "deferred log arguments must be numbers or pointers");
+  static_assert((sizeof(Args) + ... + 0) <= DeferredRecord::args_capacity,
+                "too many deferred log arguments");
+
+  DeferredRecord record;
+  record.format_fn = &format_packed<Args...>;
+  record.format = format;
+  std::size_t offset = 0;
+  ((std::memcpy(record.args + offset, &args, sizeof(Args)), offset += sizeof(Args)), ...);
+  record.args_size = static_cast<uint8_t>(offset);
+  return record;
+}
+
+} // namespace detail
+
 class LogStore {
 public:
   LogStore();
+  ~LogStore();
+
+  LogStore(const LogStore &) = delete;
+  LogStore &operator=(const LogStore &) = delete;
 
-  void log(esp_log_level_t level, std::string_view tag, std::string message);
+  void log(esp_log_level_t level, std::string_view tag, std::string_view message);
+  void log(esp_log_level_t level, std::string_view tag, std::string_view message,
+           uint32_t timestamp_ms);
+  // The arena backend keeps the record unformatted; the deque backend formats
+  // it straight away.
+  void log(esp_log_level_t level, std::string_view tag,
+           const DeferredRecord &record);
+  void log(esp_log_level_t level, std::string_view tag,
+           const DeferredRecord &record, uint32_t timestamp_ms);
   LogBatch collect(uint64_t cursor, std::size_t limit) const;
   void clear();
 
+  // Entries carried over from before the last reset
+  // (CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST). They are the oldest entries in
+  // the store, so collect(0, recovered()) returns exactly those.
+  std::size_t recovered() const;
+
+  // Calls `visitor` with up to `limit` entries after `cursor` without copying
+  // them. The store is locked for `visit_chunk` entries at a time so the views
+  // cannot be overwritten, and released between chunks so producers are not
+  // held up by a long visit; entries evicted in between are skipped, as with
+  // collect(). Keep the visitor short and do not log from inside it. A
+  // visitor returning false stops the visit and that entry is not counted,
+  // so the returned cursor resumes at it.
+  template <typename Visitor>
+  LogVisitResult for_each_since(uint64_t cursor, std::size_t limit,
+                                Visitor &&visitor) const {
+    using Fn = std::remove_reference_t<Visitor>;
+    auto trampoline = [](void *context, const LogView &view) -> bool {
+      Fn &fn = *static_cast<Fn *>(context);
+      if constexpr (std::is_void_v<std::invoke_result_t<Fn &, const LogView &>>) {
+        fn(view);
+        return true;
+      } else {
+        return static_cast<bool>(fn(view));
+      }
+    };
+    return visit(cursor, limit, trampoline,
+                 const_cast<void *>(static_cast<const void *>(&visitor)));
+  }
+
   static constexpr std::size_t max_entries = 1024;
+  static constexpr std::size_t visit_chunk = 16;
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA
+  static constexpr std::size_t arena_size = CONFIG_EARBRAIN_LOG_STORE_ARENA_SIZE;
+  static constexpr std::size_t arena_alignment = 4;
+  static constexpr std::size_t arena_tag_slots = CONFIG_EARBRAIN_LOG_STORE_ARENA_TAG_SLOTS;
+  static constexpr std::size_t arena_tag_name_size = 24;
+#endif
 
 private:
+  using VisitFn = bool (*)(void *context, const LogView &view);
+
+  LogVisitResult visit(uint64_t cursor, std::size_t limit, VisitFn fn,
+                       void *context) const;
+
+  // Backend accessors; callers hold `mutex`.
+  std::size_t stored() const;
+  uint64_t first_after(uint64_t cursor) const;
+  LogView view(uint64_t id) const;
+
   mutable std::mutex mutex;
-  std::deque<LogEntry> entries;
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA
+  // Records are laid out back to back; a record that does not fit before the
+  // end of the arena starts again at offset 0 and `arena_wrap` marks where the
+  // older records end. Ids are contiguous, so `arena_index` maps an id to its
+  // record offset (in units of arena_alignment) without scanning and records
+  // do not store their id. Tags are interned into `arena_tags` and referenced
+  // by index; tags that do not fit the table are stored inline.
+  static constexpr std::size_t arena_index_capacity = arena_size / 16;
+  using ArenaSlot = std::conditional_t<(arena_size / arena_alignment) <= UINT16_MAX,
+                                       uint16_t, uint32_t>;
+
+  struct ArenaTag {
+    char name[arena_tag_name_size];
+    uint8_t len;
+  };
+
+  void arena_push(uint32_t timestamp_ms, esp_log_level_t level,
+                  std::string_view tag, uint8_t kind, std::string_view body);
+  void arena_evict();
+  uint8_t arena_intern(std::string_view tag);
+  std::size_t arena_offset(uint64_t id) const;
+  // Mirrors the ring state into the persistent block; a no-op otherwise.
+  void arena_persist();
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+  bool arena_recover();
+#endif
+
+  uint8_t *arena;
+  ArenaSlot *arena_index;
+  std::size_t arena_capacity;
+  std::size_t arena_head;
+  std::size_t arena_tail;
+  std::size_t arena_wrap;
+  std::size_t arena_count;
+  // Entries written before this id came from an earlier boot.
+  uint64_t arena_boot_id;
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+  std::size_t arena_recovered;
+  // Deferred records from another firmware image point at stale code.
+  bool arena_foreign_image;
+#endif
+  ArenaTag arena_tags[arena_tag_slots];
+  std::size_t arena_tag_count;
+  // Deferred records are formatted here when they are read back.
+  mutable char arena_scratch[CONFIG_EARBRAIN_LOG_FORMAT_BUFFER_SIZE];
+#else
+  std::deque<LogEntry, TrackedAllocator<LogEntry, MemoryTag::Logging>> entries;
+#endif
   uint64_t next_id;
 };
 
@@ -58,16 +263,66 @@ public:
   void debugf(const char *format, ...);
   void debugf(const char *tag, const char *format, ...);
 
+  void logf(esp_log_level_t level, std::string_view tag, const char *format, ...);
+  void vlogf(esp_log_level_t level, std::string_view tag, const char *format,
+             va_list args);
+
+  // Records the format string and raw arguments instead of the text, so the
+  // store formats them only when they are read back. `format` and any string
+  // arguments must outlive the record (string literals). Arguments are not
+  // checked against the format here; EARBRAIN_LOG_DEFERRED does that.
+  template <typename... Args>
+  void deferred(esp_log_level_t level, std::string_view tag, const char *format,
+                Args... args) {
+    if (format && enabled(level, tag)) {
+      write(level, tag, detail::make_deferred(format, args...));
+    }
+  }
+
+  // Checked before any formatting work: the compiled-in level first, then the
+  // runtime level of `tag` (or the default level when the tag has none).
+  bool enabled(esp_log_level_t level, std::string_view tag = default_tag()) const {
+    return level_compiled_in(level) && runtime_enabled(level, tag);
+  }
+
+  void level(esp_log_level_t level);
+  esp_log_level_t level() const;
+  esp_err_t level(std::string_view tag, esp_log_level_t level);
+  esp_log_level_t level(std::string_view tag) const;
+
   LogBatch collect(uint64_t cursor, std::size_t limit) const;
   void clear();
+  std::size_t recovered() const;
+
+  template <typename Visitor>
+  LogVisitResult for_each_since(uint64_t cursor, std::size_t limit,
+                                Visitor &&visitor) const {
+    return store.for_each_since(cursor, limit, std::forward<Visitor>(visitor));
+  }
+
+  // Asynchronous mode (CONFIG_EARBRAIN_LOG_ASYNC). Without it records are
+  // written synchronously, nothing is dropped and flush() returns at once.
+  void overflow_policy(OverflowPolicy policy, uint32_t block_timeout_ms = 0);
+  OverflowPolicy overflow_policy() const;
+  uint32_t dropped() const;
+  bool flush(uint32_t timeout_ms = portMAX_DELAY);
 
   static constexpr std::string_view default_tag() { return "core"; }
 
 private:
   Logger();
 
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  bool enqueue(esp_log_level_t level, std::string_view tag,
+               std::string_view payload, bool deferred);
+  void drain();
+#endif
+
+  bool runtime_enabled(esp_log_level_t level, std::string_view tag) const;
   void write(esp_log_level_t level, std::string_view tag,
              std::string_view message);
+  void write(esp_log_level_t level, std::string_view tag,
+             const DeferredRecord &record);
 
   LogStore store;
 };
@@ -88,7 +343,73 @@ void errorf(const char *tag, const char *format, ...);
 void debugf(const char *format, ...);
 void debugf(const char *tag, const char *format, ...);
 
+void level(esp_log_level_t level);
+esp_err_t level(std::string_view tag, esp_log_level_t level);
+
 LogBatch collect(uint64_t cursor, std::size_t limit);
 void clear();
+std::size_t recovered();
+uint32_t dropped();
+bool flush(uint32_t timeout_ms = portMAX_DELAY);
+
+template <typename... Args>
+void deferred(esp_log_level_t level, std::string_view tag, const char *format,
+              Args... args) {
+  get_logger().deferred(level, tag, format, args...);
+}
+
+template <typename Visitor>
+LogVisitResult for_each_since(uint64_t cursor, std::size_t limit,
+                              Visitor &&visitor) {
+  return get_logger().for_each_since(cursor, limit,
+                                     std::forward<Visitor>(visitor));
+}
+
+namespace detail {
+
+inline std::string_view as_tag(const char *tag) {
+  return tag ? std::string_view{tag} : Logger::default_tag();
+}
+
+inline std::string_view as_tag(std::string_view tag) { return tag; }
+
+// Never called; a template cannot carry the format attribute, so
+// EARBRAIN_LOG_DEFERRED routes its arguments through this for -Wformat.
+[[gnu::format(printf, 1, 2)]] inline void check_format(const char *, ...) {}
+
+} // namespace detail
 
 } // namespace earbrain::logging
+
+// Level-gated logging. Below CONFIG_EARBRAIN_LOG_MIN_LEVEL the call is
+// discarded at compile time; otherwise the runtime level table is consulted
+// before the arguments are evaluated or formatted.
+#define EARBRAIN_LOG(level, tag, format, ...)                                  \
+  do {                                                                         \
+    if constexpr (::earbrain::logging::level_compiled_in(level)) {             \
+      auto &earbrain_logger_ = ::earbrain::logging::get_logger();              \
+      const std::string_view earbrain_tag_ = ::earbrain::logging::detail::as_tag(tag); \
+      if (earbrain_logger_.enabled(level, earbrain_tag_)) {                    \
+        earbrain_logger_.logf(level, earbrain_tag_, format __VA_OPT__(, ) __VA_ARGS__); \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#define EARBRAIN_LOGE(tag, format, ...) EARBRAIN_LOG(ESP_LOG_ERROR, tag, format __VA_OPT__(, ) __VA_ARGS__)
+#define EARBRAIN_LOGW(tag, format, ...) EARBRAIN_LOG(ESP_LOG_WARN, tag, format __VA_OPT__(, ) __VA_ARGS__)
+#define EARBRAIN_LOGI(tag, format, ...) EARBRAIN_LOG(ESP_LOG_INFO, tag, format __VA_OPT__(, ) __VA_ARGS__)
+#define EARBRAIN_LOGD(tag, format, ...) EARBRAIN_LOG(ESP_LOG_DEBUG, tag, format __VA_OPT__(, ) __VA_ARGS__)
+#define EARBRAIN_LOGV(tag, format, ...) EARBRAIN_LOG(ESP_LOG_VERBOSE, tag, format __VA_OPT__(, ) __VA_ARGS__)
+
+// Logger::deferred() with the arguments checked against the format at
+// compile time, like any printf call.
+#define EARBRAIN_LOG_DEFERRED(level, tag, format, ...)                         \
+  do {                                                                         \
+    if (false) {                                                               \
+      ::earbrain::logging::detail::check_format(format __VA_OPT__(, ) __VA_ARGS__); \
+    }                                                                          \
+    if constexpr (::earbrain::logging::level_compiled_in(level)) {             \
+      ::earbrain::logging::get_logger().deferred(                              \
+          level, ::earbrain::logging::detail::as_tag(tag), format __VA_OPT__(, ) __VA_ARGS__); \
+    }                                                                          \
+  } while (0)
@@ -1,18 +1,56 @@
 #pragma once
 
+#include "earbrain/memory_tracking.hpp"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace earbrain {
 
+class WifiService;
+struct WifiEventData;
+
+using MdnsTxt = std::map<std::string, std::string>;
+
+// One advertised service, identified by its type and protocol.
+struct MdnsServiceInfo {
+  std::string service_type = "_http";
+  std::string protocol = "_tcp";
+  uint16_t port = 80;
+  // Empty uses MdnsConfig::instance_name.
+  std::string instance_name;
+  MdnsTxt txt;
+};
+
 struct MdnsConfig {
   std::string hostname = "esp-device";
   std::string instance_name = "ESP Device";
+  // The primary service; an empty service_type advertises none.
   std::string service_type = "_http";
   std::string protocol = "_tcp";
   uint16_t port = 80;
+  MdnsTxt txt;
+  // Advertised next to the primary service.
+  std::vector<MdnsServiceInfo> services;
+};
+
+// How an attached responder follows the station link.
+struct MdnsLinkPolicy {
+  uint32_t hold_ms = CONFIG_EARBRAIN_MDNS_LINK_HOLD_MS;
+  uint32_t min_announce_interval_ms = CONFIG_EARBRAIN_MDNS_ANNOUNCE_MIN_INTERVAL_MS;
+  uint32_t announce_jitter_ms = CONFIG_EARBRAIN_MDNS_ANNOUNCE_JITTER_MS;
 };
 
+// Changes to a running responder are applied as differences: only the
+// records that changed are re-announced, and only a new hostname makes the
+// responder probe again.
 class MdnsService {
 public:
   MdnsService() = default;
@@ -23,19 +61,79 @@ public:
   MdnsService &operator=(MdnsService &&) = delete;
 
   esp_err_t initialize();
+  // When already running, moves the responder to `config` without
+  // restarting it.
   esp_err_t start(const MdnsConfig &config);
   esp_err_t start();
   esp_err_t stop();
   bool is_running() const noexcept { return running; }
-  const MdnsConfig &config() const noexcept { return mdns_config; }
+  MdnsConfig config() const;
+
+  // Adds the service, or updates the one with the same type and protocol.
+  esp_err_t add_service(const MdnsServiceInfo &service);
+  esp_err_t remove_service(std::string_view service_type, std::string_view protocol);
+  // config() and services() hold what was asked for. What the responder
+  // actually has can lag behind after a failed add or update, until the
+  // next change or start() retries it.
+  std::vector<MdnsServiceInfo> services() const;
+  std::vector<MdnsServiceInfo> advertised_services() const;
+
+  // Applies every entry in one TXT update and one announcement; a nullopt
+  // value removes the key.
+  esp_err_t update_txt(std::string_view service_type, std::string_view protocol,
+                       const std::map<std::string, std::optional<std::string>> &changes);
+  esp_err_t set_txt(std::string_view service_type, std::string_view protocol,
+                    std::string_view key, std::string_view value);
+  esp_err_t remove_txt(std::string_view service_type, std::string_view protocol,
+                       std::string_view key);
+
+  esp_err_t hostname(std::string_view name);
+  esp_err_t instance_name(std::string_view name);
+
+  // Starts the responder with `config` once the station has an address and
+  // keeps it running across disconnects shorter than policy.hold_ms.
+  // Reconnecting with the same address announces nothing; a new address
+  // is announced after a random delay and at most once per
+  // min_announce_interval_ms.
+  esp_err_t attach(WifiService &wifi, const MdnsConfig &config,
+                   const MdnsLinkPolicy &policy = {});
+  // Stops following the link; the responder keeps its current state.
+  void detach();
+  bool is_attached() const;
 
 private:
+  esp_err_t initialize_locked();
+  esp_err_t start_locked(const MdnsConfig &config);
+  esp_err_t apply_services(std::vector<MdnsServiceInfo> next);
+  esp_err_t stop_locked();
+
+  void on_link_event(const WifiEventData &event);
+  void schedule_announce();
+  void announce();
+  void hold_expired();
+  static void on_announce_timer(void *arg);
+  static void on_hold_timer(void *arg);
+
+  mutable std::mutex mutex;
+  // As requested; see advertised for what went out.
   MdnsConfig mdns_config;
+  // What the responder currently advertises, primary service first.
+  std::vector<MdnsServiceInfo, TrackedAllocator<MdnsServiceInfo, MemoryTag::Mdns>> advertised;
   bool initialized = false;
-  bool service_registered = false;
   bool running = false;
-  std::string registered_service_type;
-  std::string registered_protocol;
+
+  // Link binding, see attach().
+  WifiService *attached_wifi = nullptr;
+  uint32_t link_subscription = 0;
+  MdnsLinkPolicy link_policy;
+  bool link_up = false;
+  uint32_t link_ip = 0;
+  // Address last announced; 0 before the first one.
+  uint32_t announced_ip = 0;
+  int64_t last_announce_us = 0;
+  bool announce_pending = false;
+  esp_timer_handle_t announce_timer = nullptr;
+  esp_timer_handle_t hold_timer = nullptr;
 };
 
 MdnsService &mdns();
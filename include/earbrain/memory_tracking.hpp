@@ -0,0 +1,114 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace earbrain {
+
+// Library subsystems that heap use is attributed to.
+enum class MemoryTag : uint8_t {
+  Logging,
+  Wifi,
+  Mdns,
+  Tasks
+};
+
+inline constexpr std::size_t memory_tag_count = 4;
+
+#if CONFIG_EARBRAIN_MEMORY_TRACKING
+inline constexpr bool memory_tracking_enabled = true;
+#else
+inline constexpr bool memory_tracking_enabled = false;
+#endif
+
+namespace detail {
+
+struct MemoryCounters {
+  std::atomic<uint32_t> live_bytes{0};
+  std::atomic<uint32_t> peak_bytes{0};
+  std::atomic<uint32_t> allocations{0};
+  std::atomic<uint32_t> live_allocations{0};
+};
+
+extern MemoryCounters memory_counters[memory_tag_count];
+
+// A few relaxed atomic adds per allocation, and nothing at all with
+// CONFIG_EARBRAIN_MEMORY_TRACKING off.
+inline void note_allocation(MemoryTag tag, std::size_t size) {
+  if constexpr (memory_tracking_enabled) {
+    MemoryCounters &counters = memory_counters[static_cast<std::size_t>(tag)];
+    const auto bytes = static_cast<uint32_t>(size);
+    const uint32_t live = counters.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.live_allocations.fetch_add(1, std::memory_order_relaxed);
+    uint32_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+  }
+}
+
+inline void note_deallocation(MemoryTag tag, std::size_t size) {
+  if constexpr (memory_tracking_enabled) {
+    MemoryCounters &counters = memory_counters[static_cast<std::size_t>(tag)];
+    counters.live_bytes.fetch_sub(static_cast<uint32_t>(size), std::memory_order_relaxed);
+    counters.live_allocations.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+} // namespace detail
+
+// Standard allocator that charges its allocations to `Tag`.
+template <typename T, MemoryTag Tag>
+class TrackedAllocator {
+public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = TrackedAllocator<U, Tag>;
+  };
+
+  TrackedAllocator() noexcept = default;
+  template <typename U>
+  TrackedAllocator(const TrackedAllocator<U, Tag> &) noexcept {}
+
+  T *allocate(std::size_t count) {
+    T *memory = static_cast<T *>(::operator new(count * sizeof(T)));
+    detail::note_allocation(Tag, count * sizeof(T));
+    return memory;
+  }
+
+  void deallocate(T *memory, std::size_t count) noexcept {
+    detail::note_deallocation(Tag, count * sizeof(T));
+    ::operator delete(memory);
+  }
+
+  template <typename U>
+  bool operator==(const TrackedAllocator<U, Tag> &) const noexcept {
+    return true;
+  }
+};
+
+// new/delete for a single object charged to `Tag`.
+template <typename T, typename... Args>
+T *tracked_new(MemoryTag tag, Args &&...args) {
+  T *object = new T(std::forward<Args>(args)...);
+  detail::note_allocation(tag, sizeof(T));
+  return object;
+}
+
+template <typename T>
+void tracked_delete(MemoryTag tag, T *object) noexcept {
+  if (object) {
+    detail::note_deallocation(tag, sizeof(T));
+    delete object;
+  }
+}
+
+} // namespace earbrain
@@ -1,6 +1,18 @@
 #pragma once
 
+#include "earbrain/memory_tracking.hpp"
+#include "earbrain/time_series.hpp"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_timer.h"
+#endif
+
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <mutex>
 
 namespace earbrain {
 
@@ -15,4 +27,193 @@ struct Metrics {
 
 Metrics collect_metrics();
 
+// Heaps that collect_heap_metrics() can report on, by MALLOC_CAP_* capability.
+enum class HeapKind : std::uint8_t {
+  Internal,
+  Spiram,
+  Dma,
+  Exec
+};
+
+inline constexpr std::size_t heap_kind_count = 4;
+
+constexpr std::uint32_t heap_mask(HeapKind kind) {
+  return std::uint32_t{1} << static_cast<unsigned>(kind);
+}
+
+inline constexpr std::uint32_t all_heaps = (std::uint32_t{1} << heap_kind_count) - 1;
+
+struct HeapMetrics {
+  bool sampled;
+  std::uint32_t total;
+  std::uint32_t free;
+  std::uint32_t min_free;
+  std::uint32_t largest_free_block;
+  std::uint32_t allocated_blocks;
+  std::uint32_t free_blocks;
+  // largest_free_block / free: 1.0 when all free memory is one block, lower
+  // as it fragments. 0 when nothing is free.
+  float fragmentation_ratio;
+};
+
+struct HeapSnapshot {
+  std::uint64_t timestamp_ms = 0;
+  std::array<HeapMetrics, heap_kind_count> heaps{};
+
+  const HeapMetrics &operator[](HeapKind kind) const {
+    return heaps[static_cast<std::size_t>(kind)];
+  }
+};
+
+// Only the heaps in `mask` (a combination of heap_mask() values) are queried;
+// each one costs a heap_caps_get_info() walk.
+HeapSnapshot collect_heap_metrics(std::uint32_t mask = all_heaps);
+
+struct TaskMetrics {
+  char name[configMAX_TASK_NAME_LEN];
+  std::uint32_t priority;
+  // Bytes of stack that have never been used.
+  std::uint32_t stack_high_water;
+  // Core the task is pinned to, or -1.
+  std::int32_t core;
+  // Run-time counter ticks since the previous snapshot.
+  std::uint32_t runtime;
+  // Share of one core over the interval.
+  float cpu_percent;
+};
+
+// Caller-owned so that taking a snapshot never allocates. CPU figures are
+// deltas against the previous collect_task_metrics() call (or boot).
+struct TaskSnapshot {
+  std::size_t count = 0;
+  std::uint32_t interval = 0;
+  std::array<float, portNUM_PROCESSORS> core_load{};
+  std::array<TaskMetrics, CONFIG_EARBRAIN_METRICS_MAX_TASKS> tasks{};
+};
+
+// Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS; returns ESP_ERR_NOT_SUPPORTED
+// without them and ESP_ERR_INVALID_SIZE when more tasks exist than
+// CONFIG_EARBRAIN_METRICS_MAX_TASKS.
+esp_err_t collect_task_metrics(TaskSnapshot &snapshot);
+
+struct MemoryUsage {
+  std::uint32_t live_bytes;
+  std::uint32_t peak_bytes;
+  // Allocations since boot, and those not yet freed.
+  std::uint32_t allocations;
+  std::uint32_t live_allocations;
+};
+
+// Heap use of the library's own allocations by subsystem. All zero, and
+// `enabled` false, without CONFIG_EARBRAIN_MEMORY_TRACKING.
+struct MemorySnapshot {
+  bool enabled = memory_tracking_enabled;
+  std::uint64_t timestamp_ms = 0;
+  std::array<MemoryUsage, memory_tag_count> tags{};
+
+  const MemoryUsage &operator[](MemoryTag tag) const {
+    return tags[static_cast<std::size_t>(tag)];
+  }
+};
+
+MemorySnapshot collect_memory_usage();
+// Restarts peak tracking from the current live bytes.
+void reset_memory_peaks();
+
+// One background sample. `timestamp_ms` is the low 32 bits of the uptime.
+struct MetricsSample {
+  std::uint32_t timestamp_ms;
+  std::uint32_t heap_free;
+  std::uint32_t heap_min_free;
+  std::uint32_t heap_largest_free_block;
+};
+
+struct MetricsStat {
+  std::uint32_t min;
+  std::uint32_t max;
+  std::uint32_t avg;
+};
+
+// Samples folded over one window of the chosen resolution.
+struct MetricsRollup {
+  std::uint32_t start_s;
+  std::uint32_t samples;
+  std::uint32_t heap_min_free;
+  MetricsStat heap_free;
+  MetricsStat heap_largest_free_block;
+};
+
+enum class MetricsResolution {
+  Second,
+  Minute,
+  Hour
+};
+
+// Samples collect_metrics() on an esp_timer and keeps the raw samples plus
+// per-second, per-minute and per-hour rollups in preallocated rings, so a
+// running sampler never allocates.
+class MetricsSampler {
+public:
+  static constexpr uint32_t default_period_ms = CONFIG_EARBRAIN_METRICS_SAMPLE_PERIOD_MS;
+
+  MetricsSampler() = default;
+  ~MetricsSampler();
+
+  MetricsSampler(const MetricsSampler &) = delete;
+  MetricsSampler &operator=(const MetricsSampler &) = delete;
+  MetricsSampler(MetricsSampler &&) = delete;
+  MetricsSampler &operator=(MetricsSampler &&) = delete;
+
+  esp_err_t start(uint32_t period_ms = default_period_ms);
+  esp_err_t stop();
+  bool is_running() const noexcept { return running; }
+  uint32_t period_ms() const noexcept { return period; }
+
+  // Takes one sample immediately; the timer calls this every period.
+  void sample();
+
+  SeriesBatch<MetricsSample> collect(uint64_t cursor, std::size_t limit) const;
+  SeriesBatch<MetricsRollup> collect(MetricsResolution resolution, uint64_t cursor,
+                                     std::size_t limit) const;
+  void clear();
+
+private:
+  struct Accumulator {
+    bool active = false;
+    std::uint32_t window = 0;
+    std::uint32_t samples = 0;
+    std::uint32_t heap_min_free = 0;
+    MetricsStat heap_free{};
+    MetricsStat heap_largest_free_block{};
+    std::uint64_t heap_free_sum = 0;
+    std::uint64_t heap_largest_free_block_sum = 0;
+  };
+
+  using RawSeries = TimeSeries<MetricsSample, CONFIG_EARBRAIN_METRICS_RAW_SAMPLES>;
+  using SecondSeries = TimeSeries<MetricsRollup, CONFIG_EARBRAIN_METRICS_SECOND_ROLLUPS>;
+  using MinuteSeries = TimeSeries<MetricsRollup, CONFIG_EARBRAIN_METRICS_MINUTE_ROLLUPS>;
+  using HourSeries = TimeSeries<MetricsRollup, CONFIG_EARBRAIN_METRICS_HOUR_ROLLUPS>;
+
+  static void on_timer(void *arg);
+  void roll(std::uint32_t now_s);
+
+  mutable std::mutex mutex;
+#if !CONFIG_IDF_TARGET_LINUX
+  esp_timer_handle_t timer = nullptr;
+#endif
+  uint32_t period = 0;
+  bool running = false;
+
+  RawSeries raw;
+  SecondSeries seconds;
+  MinuteSeries minutes;
+  HourSeries hours;
+  Accumulator second_window;
+  Accumulator minute_window;
+  Accumulator hour_window;
+};
+
+MetricsSampler &metrics_sampler();
+
 } // namespace earbrain
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "earbrain/completion.hpp"
+#include "earbrain/task_pool.hpp"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+namespace earbrain::tasks {
+
+// Counts outstanding jobs spawned against it; wait() returns once all of
+// them have run. One task may wait on a handle at a time.
+class JoinHandle {
+public:
+  JoinHandle() = default;
+  ~JoinHandle();
+
+  JoinHandle(const JoinHandle &) = delete;
+  JoinHandle &operator=(const JoinHandle &) = delete;
+  JoinHandle(JoinHandle &&) = delete;
+  JoinHandle &operator=(JoinHandle &&) = delete;
+
+  bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+  bool wait(uint32_t timeout_ms = portMAX_DELAY);
+
+private:
+  friend class Scheduler;
+  template <typename Index, typename Func>
+  friend void parallel_for(Index begin, Index end, Index grain, Func &&func);
+
+  void add() { pending.fetch_add(1, std::memory_order_relaxed); }
+  // `finishing` covers the gap between the last decrement and complete(),
+  // so a waiter that already sees done() cannot destroy the handle under us.
+  void finish() {
+    finishing.fetch_add(1, std::memory_order_acq_rel);
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      completion.complete(true);
+    }
+    finishing.fetch_sub(1, std::memory_order_release);
+  }
+
+  std::atomic<std::size_t> pending{0};
+  std::atomic<std::size_t> finishing{0};
+  Completion<bool> completion;
+};
+
+// One worker pinned to each core, each with its own job deque. A worker runs
+// its newest job first and, when its deque is empty, steals the oldest job
+// from the other core.
+class Scheduler {
+public:
+  static constexpr std::size_t deque_capacity = CONFIG_EARBRAIN_SCHEDULER_DEQUE_SIZE;
+  static constexpr std::size_t worker_count = portNUM_PROCESSORS;
+
+  Scheduler() = default;
+  ~Scheduler();
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+  Scheduler(Scheduler &&) = delete;
+  Scheduler &operator=(Scheduler &&) = delete;
+
+  esp_err_t start();
+  // Jobs still queued run on the calling task before stop() returns.
+  esp_err_t stop();
+  bool is_running() const noexcept { return running.load(); }
+
+  // Queues `job` on `core`'s deque (the caller's core by default). When the
+  // scheduler is stopped or the deque is full the job runs on the caller.
+  void spawn(JoinHandle &join, Job job, int core = -1);
+
+  // Runs queued jobs on the calling task until `join` is done.
+  void join(JoinHandle &join);
+
+private:
+  struct Entry {
+    Job job;
+    JoinHandle *join = nullptr;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    Entry entries[deque_capacity];
+    std::size_t head = 0;
+    std::size_t count = 0;
+    TaskHandle_t task = nullptr;
+  };
+
+  static void worker_main(void *param);
+
+  bool push(std::size_t index, Entry &entry);
+  bool pop(std::size_t index, Entry &entry);
+  bool steal(std::size_t index, Entry &entry);
+  bool run_one(std::size_t index);
+  static void run(Entry &entry);
+  std::size_t current_index() const;
+
+  Worker workers[worker_count];
+  std::atomic<bool> running{false};
+  std::atomic<bool> stopping{false};
+  std::atomic<std::size_t> exited{0};
+};
+
+// Shared scheduler, started on first use.
+Scheduler &scheduler();
+
+// Calls `func(i)` for every i in [begin, end), in chunks of `grain` spread
+// over both cores. The calling task helps and returns once all chunks ran.
+template <typename Index, typename Func>
+void parallel_for(Index begin, Index end, Index grain, Func &&func) {
+  if (!(begin < end)) {
+    return;
+  }
+  if (grain < Index{1}) {
+    grain = Index{1};
+  }
+
+  Scheduler &sched = scheduler();
+  JoinHandle join;
+  // Held open while spawning so early chunks cannot complete it too soon.
+  join.add();
+  std::size_t chunk = 0;
+  for (Index first = begin; first < end; ++chunk) {
+    const Index last = (end - first > grain) ? first + grain : end;
+    sched.spawn(join, Job([&func, first, last]() {
+                  for (Index i = first; i < last; ++i) {
+                    func(i);
+                  }
+                }),
+                static_cast<int>(chunk % Scheduler::worker_count));
+    first = last;
+  }
+  join.finish();
+  sched.join(join);
+}
+
+} // namespace earbrain::tasks
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace earbrain {
+
+// Single value published for many readers. Readers never block the writer:
+// they copy the value and retry when a write overlapped the copy. Writers
+// serialize on a spinlock critical section, so the update callback must be
+// short and must not block.
+template <typename T>
+class Seqlock {
+  static_assert(std::is_trivially_copyable_v<T>, "Seqlock needs a trivially copyable type");
+
+public:
+  Seqlock() { store_words(T{}); }
+  explicit Seqlock(const T &initial) { store_words(initial); }
+
+  Seqlock(const Seqlock &) = delete;
+  Seqlock &operator=(const Seqlock &) = delete;
+
+  // Calls `update(value)` on the current value and publishes the result.
+  template <typename F>
+  void write(F &&update) {
+    portENTER_CRITICAL(&writer_lock);
+    T value = load_words();
+    update(value);
+    const uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store_words(value);
+    sequence.store(seq + 2, std::memory_order_release);
+    portEXIT_CRITICAL(&writer_lock);
+  }
+
+  void store(const T &value) {
+    write([&](T &current) { current = value; });
+  }
+
+  T load(uint32_t *generation = nullptr) const {
+    for (unsigned spins = 0;; ++spins) {
+      const uint32_t before = sequence.load(std::memory_order_acquire);
+      if ((before & 1) == 0) {
+        T value = load_words();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before) {
+          if (generation) {
+            *generation = before / 2;
+          }
+          return value;
+        }
+      }
+      // The writer may be on the other core; give it a moment.
+      if (spins > 16) {
+        taskYIELD();
+      }
+    }
+  }
+
+  // Bumped by every write. Comparing against a saved generation is the
+  // cheap way to find out whether load() would return anything new.
+  uint32_t generation() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+  static constexpr std::size_t word_count = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+  T load_words() const {
+    uint32_t buffer[word_count];
+    for (std::size_t i = 0; i < word_count; ++i) {
+      buffer[i] = words[i].load(std::memory_order_relaxed);
+    }
+    T value;
+    std::memcpy(&value, buffer, sizeof(T));
+    return value;
+  }
+
+  void store_words(const T &value) {
+    uint32_t buffer[word_count] = {};
+    std::memcpy(buffer, &value, sizeof(T));
+    for (std::size_t i = 0; i < word_count; ++i) {
+      words[i].store(buffer[i], std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint32_t> sequence{0};
+  std::atomic<uint32_t> words[word_count];
+  portMUX_TYPE writer_lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+} // namespace earbrain
@@ -1,10 +1,18 @@
 #pragma once
 
+#include "earbrain/inline_function.hpp"
+#include "earbrain/memory_tracking.hpp"
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "sdkconfig.h"
+#if CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+#include "esp_heap_caps.h"
+#endif
 
-#include <functional>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
 #include <utility>
 
 namespace earbrain::tasks {
@@ -13,21 +21,147 @@ template <typename Func>
 esp_err_t run_detached(Func &&func, const char *name,
                        size_t stack_size = 4096,
                        UBaseType_t priority = 5) {
-  auto *task_func = new std::function<void()>(std::forward<Func>(func));
+  using Body = std::decay_t<Func>;
+  auto *task_func = tracked_new<Body>(MemoryTag::Tasks, std::forward<Func>(func));
 
   auto wrapper = [](void *param) {
-    auto *f = static_cast<std::function<void()> *>(param);
+    auto *f = static_cast<Body *>(param);
     (*f)();
-    delete f;
+    tracked_delete(MemoryTag::Tasks, f);
     vTaskDelete(nullptr);
   };
 
   BaseType_t result = xTaskCreate(wrapper, name, stack_size, task_func, priority, nullptr);
   if (result != pdPASS) {
-    delete task_func;
+    tracked_delete(MemoryTag::Tasks, task_func);
     return ESP_FAIL;
   }
   return ESP_OK;
 }
 
+enum class StackMemory {
+  Internal,
+  // Needs CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY. Tasks with a PSRAM
+  // stack must not run while the flash cache is disabled (flash writes, NVS
+  // commits).
+  Psram,
+};
+
+// Task whose TCB and stack live inside the object instead of being taken
+// from the heap, so a `static StaticTask<N>` fixes its memory at link time.
+// With StackMemory::Psram the stack is allocated from PSRAM by start() and
+// never freed; the TCB always stays in the object.
+//
+// A StaticTask runs once: FreeRTOS may still reference the TCB after the
+// body returns, so the storage is never reused. The body is stored inline
+// and must fit in Body.
+template <std::size_t StackSize, StackMemory Memory = StackMemory::Internal>
+class StaticTask {
+public:
+  static_assert(StackSize >= configMINIMAL_STACK_SIZE, "stack too small");
+
+  using Body = InlineFunction<void(), 32>;
+
+  StaticTask() = default;
+
+  StaticTask(const StaticTask &) = delete;
+  StaticTask &operator=(const StaticTask &) = delete;
+  StaticTask(StaticTask &&) = delete;
+  StaticTask &operator=(StaticTask &&) = delete;
+
+  // `core` is a core number or tskNO_AFFINITY. Returns
+  // ESP_ERR_INVALID_STATE when the task has already been started and
+  // ESP_ERR_NOT_SUPPORTED for a PSRAM stack the configuration does not
+  // allow.
+  template <typename Func>
+  esp_err_t start(Func &&func, const char *name, UBaseType_t priority = 5,
+                  BaseType_t core = tskNO_AFFINITY) {
+    static_assert(Body::template fits_inline<Func>(),
+                  "StaticTask body must fit in Body without a heap allocation");
+    if (started) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    if constexpr (Memory == StackMemory::Psram) {
+#if !CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+      return ESP_ERR_NOT_SUPPORTED;
+#endif
+    }
+
+    StackType_t *stack = stack_memory();
+    if (!stack) {
+      return Memory == StackMemory::Psram ? ESP_ERR_NO_MEM : ESP_FAIL;
+    }
+
+    body = Body(std::forward<Func>(func));
+    started = true;
+    running.store(true);
+#if CONFIG_IDF_TARGET_LINUX
+    // The POSIX port has no core affinity.
+    (void)core;
+    task = xTaskCreateStatic(&StaticTask::entry, name, stack_depth, this, priority, stack,
+                             &tcb);
+#else
+    task = xTaskCreateStaticPinnedToCore(&StaticTask::entry, name, stack_depth,
+                                         this, priority, stack, &tcb, core);
+#endif
+    if (!task) {
+#if CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+      if constexpr (Memory == StackMemory::Psram) {
+        detail::note_deallocation(MemoryTag::Tasks, stack_depth * sizeof(StackType_t));
+        heap_caps_free(stack);
+      }
+#endif
+      body = nullptr;
+      started = false;
+      running.store(false);
+      return ESP_FAIL;
+    }
+    return ESP_OK;
+  }
+
+  // False once the body has returned.
+  bool is_running() const noexcept { return running.load(); }
+  TaskHandle_t handle() const noexcept { return is_running() ? task : nullptr; }
+
+private:
+  static constexpr std::size_t stack_depth = StackSize / sizeof(StackType_t);
+
+  static void entry(void *param) {
+    auto *self = static_cast<StaticTask *>(param);
+    self->body();
+    self->body = nullptr;
+    self->running.store(false);
+    vTaskDelete(nullptr);
+  }
+
+  StackType_t *stack_memory() {
+    if constexpr (Memory == StackMemory::Internal) {
+      return stack;
+    } else {
+#if CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+      auto *memory = static_cast<StackType_t *>(
+          heap_caps_malloc(stack_depth * sizeof(StackType_t),
+                           MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+      if (memory) {
+        detail::note_allocation(MemoryTag::Tasks, stack_depth * sizeof(StackType_t));
+      }
+      return memory;
+#else
+      return nullptr;
+#endif
+    }
+  }
+
+  struct NoStack {};
+
+  StaticTask_t tcb{};
+  [[no_unique_address]] std::conditional_t<Memory == StackMemory::Internal,
+                                           StackType_t[stack_depth], NoStack>
+      stack;
+  Body body;
+  TaskHandle_t task = nullptr;
+  bool started = false;
+  std::atomic<bool> running{false};
+};
+
 } // namespace earbrain::tasks
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "earbrain/completion.hpp"
+#include "earbrain/inline_function.hpp"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace earbrain::tasks {
+
+using Job = InlineFunction<void(), CONFIG_EARBRAIN_TASK_POOL_JOB_SIZE>;
+
+struct TaskPoolConfig {
+  // One worker per core by default; workers are pinned round-robin.
+  std::size_t workers = portNUM_PROCESSORS;
+  bool pin_to_cores = true;
+  uint32_t stack_size = CONFIG_EARBRAIN_TASK_POOL_STACK_SIZE;
+  UBaseType_t priority = CONFIG_EARBRAIN_TASK_POOL_PRIORITY;
+  const char *name = "pool";
+};
+
+// Fixed set of worker tasks fed from a bounded job queue
+// (CONFIG_EARBRAIN_TASK_POOL_QUEUE_LENGTH). Submitting a job allocates
+// nothing as long as the callable fits in a Job.
+class TaskPool {
+public:
+  static constexpr std::size_t max_workers = 8;
+
+  TaskPool() = default;
+  ~TaskPool();
+
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+  TaskPool(TaskPool &&) = delete;
+  TaskPool &operator=(TaskPool &&) = delete;
+
+  esp_err_t start(const TaskPoolConfig &config);
+  esp_err_t start();
+  // Waits for running jobs and for submit() calls in progress to finish;
+  // queued jobs are discarded.
+  esp_err_t stop();
+  bool is_running() const noexcept { return state.load() != nullptr; }
+
+  // Returns ESP_ERR_TIMEOUT when the queue stays full for `timeout_ms` and
+  // ESP_ERR_INVALID_STATE when the pool is not running.
+  esp_err_t submit(Job job, uint32_t timeout_ms = 0);
+
+  // Runs `func` on the pool and hands its result to `completion`, which
+  // must outlive the job.
+  template <typename Func, typename R = std::invoke_result_t<std::decay_t<Func> &>>
+  esp_err_t submit(Func &&func, Completion<R> &completion, uint32_t timeout_ms = 0) {
+    static_assert(!std::is_void_v<R>, "Completion needs a result type");
+    return submit(Job([func = std::forward<Func>(func), &completion]() mutable {
+                    completion.complete(func());
+                  }),
+                  timeout_ms);
+  }
+
+  // True when called from one of this pool's workers.
+  bool in_worker() const;
+
+private:
+  struct State;
+
+  class Use;
+
+  static void worker(void *param);
+
+  std::atomic<State *> state{nullptr};
+  // Callers of submit() and in_worker() that may still touch `state`;
+  // stop() frees it only once this drops to zero.
+  mutable std::atomic<uint32_t> users{0};
+};
+
+// Shared pool, started with the default configuration on first use. A
+// start that failed, for example for lack of memory, is retried by the
+// next call.
+TaskPool &pool();
+
+} // namespace earbrain::tasks
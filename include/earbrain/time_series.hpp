@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace earbrain {
+
+template <typename T>
+struct SeriesBatch {
+  std::vector<T> samples;
+  uint64_t next_cursor = 0;
+  bool has_more = false;
+};
+
+// Fixed-capacity ring of samples. Ids are contiguous and start at 1, so a
+// cursor of 0 means "from the oldest sample". Pushing never allocates; once
+// the ring is full the oldest sample is overwritten. Not synchronised: the
+// owner serialises access.
+template <typename T, std::size_t Capacity>
+class TimeSeries {
+  static_assert(Capacity > 0, "TimeSeries needs at least one slot");
+  static_assert(std::is_trivially_copyable_v<T>,
+                "TimeSeries samples are copied by value");
+
+public:
+  void push(const T &sample) {
+    slots[next_id % Capacity] = sample;
+    ++next_id;
+  }
+
+  void clear() { first_id = next_id; }
+
+  std::size_t size() const {
+    return static_cast<std::size_t>(std::min<uint64_t>(next_id - first_id, Capacity));
+  }
+
+  bool empty() const { return size() == 0; }
+  static constexpr std::size_t capacity() { return Capacity; }
+
+  // Id of the newest sample, or 0 before the first push.
+  uint64_t last_id() const { return next_id - 1; }
+
+  const T *latest() const { return empty() ? nullptr : &slots[(next_id - 1) % Capacity]; }
+
+  // Calls `visitor(id, sample)` for up to `limit` samples after `cursor` and
+  // returns the cursor to resume from.
+  template <typename Visitor>
+  uint64_t for_each_since(uint64_t cursor, std::size_t limit, Visitor &&visitor) const {
+    uint64_t id = first_after(cursor);
+    for (std::size_t visited = 0; id < next_id && visited < limit; ++id, ++visited) {
+      visitor(id, slots[id % Capacity]);
+    }
+    return std::max(cursor, id - 1);
+  }
+
+  SeriesBatch<T> collect(uint64_t cursor, std::size_t limit) const {
+    SeriesBatch<T> batch;
+    const uint64_t first = first_after(cursor);
+    const uint64_t available = first < next_id ? next_id - first : 0;
+    const std::size_t count = static_cast<std::size_t>(
+        std::min<uint64_t>(available, std::min(limit, Capacity)));
+
+    batch.samples.reserve(count);
+    batch.next_cursor =
+        for_each_since(cursor, count, [&](uint64_t, const T &sample) {
+          batch.samples.push_back(sample);
+        });
+    batch.has_more = last_id() > batch.next_cursor;
+    return batch;
+  }
+
+private:
+  uint64_t first_after(uint64_t cursor) const {
+    const uint64_t oldest_id = next_id - size();
+    return std::max(cursor + 1, oldest_id);
+  }
+
+  T slots[Capacity] = {};
+  uint64_t next_id = 1;
+  // Samples before this id were cleared.
+  uint64_t first_id = 1;
+};
+
+} // namespace earbrain
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <chrono>
+#else
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#endif
+
+namespace earbrain::trace {
+
+#if CONFIG_EARBRAIN_TRACE
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+// One finished span. Spans measured on a single core carry their length in
+// CPU cycles; spans that moved between cores, or were recorded from two
+// esp_timer readings, only in microseconds and have duration_cycles == 0.
+struct TraceEvent {
+  const char *name = nullptr;
+  int64_t start_us = 0;
+  uint32_t duration_us = 0;
+  uint32_t duration_cycles = 0;
+  uintptr_t task = 0;
+  uint8_t core = 0;
+};
+
+struct TraceBatch {
+  std::vector<TraceEvent> events;
+  uint64_t next_cursor = 0;
+  bool has_more = false;
+  // Spans overwritten before this collect reached them.
+  uint32_t dropped = 0;
+};
+
+namespace detail {
+
+#if CONFIG_IDF_TARGET_LINUX
+// The host has no cycle counter or esp_timer; nanoseconds stand in for
+// cycles.
+inline uint32_t cycle_count() {
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+inline int64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#else
+inline uint32_t cycle_count() { return esp_cpu_get_cycle_count(); }
+inline int64_t now_us() { return esp_timer_get_time(); }
+#endif
+
+inline uint8_t core_id() {
+#if portNUM_PROCESSORS > 1
+  return static_cast<uint8_t>(xPortGetCoreID());
+#else
+  return 0;
+#endif
+}
+
+void push(const TraceEvent &event);
+
+} // namespace detail
+
+// Records `name` for the lifetime of the scope. The name must outlive the
+// trace, which in practice means a string literal. Use EARBRAIN_TRACE_SCOPE
+// so the span disappears with CONFIG_EARBRAIN_TRACE off.
+class Scope {
+public:
+  explicit Scope(const char *name)
+      : name(name), start_us(detail::now_us()), start_cycles(detail::cycle_count()),
+        start_core(detail::core_id()) {}
+
+  ~Scope() {
+    const uint32_t end_cycles = detail::cycle_count();
+    TraceEvent event{};
+    event.name = name;
+    event.start_us = start_us;
+    event.duration_us = static_cast<uint32_t>(detail::now_us() - start_us);
+    event.task = reinterpret_cast<uintptr_t>(xTaskGetCurrentTaskHandle());
+    event.core = detail::core_id();
+    // Cycle counters are per core; a span that migrated keeps only the
+    // esp_timer length.
+    if (event.core == start_core) {
+      event.duration_cycles = end_cycles - start_cycles;
+    }
+    detail::push(event);
+  }
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  const char *name;
+  int64_t start_us;
+  uint32_t start_cycles;
+  uint8_t start_core;
+};
+
+// Records a span that began somewhere else, such as an association that
+// started in connect() and finished in an event handler. Both times come
+// from esp_timer_get_time().
+inline void record(const char *name, int64_t start_us, int64_t end_us) {
+  if constexpr (enabled) {
+    if (start_us <= 0 || end_us < start_us) {
+      return;
+    }
+    TraceEvent event{};
+    event.name = name;
+    event.start_us = start_us;
+    event.duration_us = static_cast<uint32_t>(end_us - start_us);
+    event.task = reinterpret_cast<uintptr_t>(xTaskGetCurrentTaskHandle());
+    event.core = detail::core_id();
+    detail::push(event);
+  }
+}
+
+// Spans recorded after `cursor`, oldest first per core; 0 starts from the
+// oldest span still held. Pass next_cursor back to continue.
+TraceBatch collect(uint64_t cursor, std::size_t limit);
+void clear();
+
+// Chrome trace event format, loadable in chrome://tracing and Perfetto.
+// Cores map to processes and tasks to threads; the part before the first
+// '.' of a span name becomes its category.
+std::string to_chrome_json(const TraceBatch &batch);
+
+} // namespace earbrain::trace
+
+#define EARBRAIN_TRACE_CONCAT_INNER(a, b) a##b
+#define EARBRAIN_TRACE_CONCAT(a, b) EARBRAIN_TRACE_CONCAT_INNER(a, b)
+
+#if CONFIG_EARBRAIN_TRACE
+#define EARBRAIN_TRACE_SCOPE(name)                                                           \
+  ::earbrain::trace::Scope EARBRAIN_TRACE_CONCAT(earbrain_trace_scope_, __LINE__) { name }
+#else
+#define EARBRAIN_TRACE_SCOPE(name) ((void)0)
+#endif
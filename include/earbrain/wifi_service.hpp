@@ -1,14 +1,22 @@
 #pragma once
 
 #include "completion.hpp"
+#include "future.hpp"
+#include "memory_tracking.hpp"
+#include "seqlock.hpp"
 #include "esp_err.h"
 #include "esp_netif_ip_addr.h"
 #include "esp_netif_types.h"
+#include "esp_timer.h"
 #include "esp_wifi_types.h"
+#include "sdkconfig.h"
+#include <array>
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -33,6 +41,48 @@ struct WifiScanResult {
   esp_err_t error = ESP_OK;
 };
 
+struct WifiScanOptions {
+  bool show_hidden = true;
+  // Sweep one channel at a time and report after each of them.
+  bool per_channel = false;
+  // Bit n selects channel n; 0 covers every channel of the current country.
+  uint16_t channels = 0;
+  // Only look for this network; empty or unset matches any.
+  std::string ssid;
+  std::optional<std::array<uint8_t, 6>> bssid;
+  wifi_scan_type_t scan_type = WIFI_SCAN_TYPE_ACTIVE;
+  // Dwell time per channel; 0 keeps the driver default. Passive scans only
+  // use max_dwell_ms.
+  uint32_t min_dwell_ms = 0;
+  uint32_t max_dwell_ms = 0;
+  // perform_scan() answers from a cached scan with the same options that is
+  // at most this old; 0 always goes on air. Either way a fresh result
+  // replaces the cached one.
+  uint32_t max_age_ms = CONFIG_EARBRAIN_WIFI_SCAN_CACHE_TTL_MS;
+
+  // Channels 1-14 of the 2.4 GHz band. Any other channel maps to bit 0,
+  // which the scan calls reject with ESP_ERR_INVALID_ARG.
+  static constexpr uint16_t valid_channels = 0x7FFE;
+  static constexpr uint16_t channel_bit(uint8_t channel) {
+    return channel >= 1 && channel <= 14 ? static_cast<uint16_t>(1u << channel) : 1;
+  }
+};
+
+// Records found on one channel (per-channel scans) or in the whole sweep
+// (channel 0). They point into the caller's buffer.
+struct WifiScanChunk {
+  uint8_t channel = 0;
+  std::span<const wifi_ap_record_t> records;
+};
+
+struct WifiScanOutcome {
+  esp_err_t error = ESP_OK;
+  // Records written to the caller's buffer.
+  uint16_t count = 0;
+  // The buffer filled up before the sweep finished.
+  bool truncated = false;
+};
+
 struct WifiCredentials {
   std::string ssid;
   std::string passphrase;
@@ -53,8 +103,58 @@ struct ProvisioningOptions {
   uint32_t timeout_ms = 120000;
 };
 
+enum class WifiPowerProfile {
+  // No modem sleep: lowest tail latency, for mains-powered devices.
+  LowLatency,
+  // Wake for every DTIM; the ESP-IDF default trade-off.
+  Balanced,
+  // Sleep across several beacons at reduced TX power, for battery nodes.
+  LowPower,
+  // Uses WifiConfig::custom_power.
+  Custom
+};
+
+struct WifiPowerSettings {
+  wifi_ps_type_t modem_sleep = WIFI_PS_MIN_MODEM;
+  // Beacons between wake-ups under WIFI_PS_MAX_MODEM. Sent in the
+  // association request, so a change applies from the next connect.
+  uint16_t listen_interval = 3;
+  // Seconds without beacons before the AP counts as lost (at least 3).
+  uint16_t beacon_timeout_s = 6;
+  // Maximum TX power in 0.25 dBm steps (8..84).
+  int8_t max_tx_power = 78;
+};
+
+constexpr WifiPowerSettings wifi_power_settings(WifiPowerProfile profile) {
+  switch (profile) {
+  case WifiPowerProfile::LowLatency:
+    return {WIFI_PS_NONE, 1, 6, 80};
+  case WifiPowerProfile::LowPower:
+    return {WIFI_PS_MAX_MODEM, 10, 15, 52};
+  case WifiPowerProfile::Balanced:
+  case WifiPowerProfile::Custom:
+  default:
+    return {};
+  }
+}
+
+constexpr WifiPowerProfile default_wifi_power_profile =
+#if CONFIG_EARBRAIN_WIFI_POWER_LOW_LATENCY
+    WifiPowerProfile::LowLatency;
+#elif CONFIG_EARBRAIN_WIFI_POWER_LOW_POWER
+    WifiPowerProfile::LowPower;
+#else
+    WifiPowerProfile::Balanced;
+#endif
+
 struct WifiConfig {
   AccessPointConfig ap_config;
+  WifiPowerProfile power_profile = default_wifi_power_profile;
+  WifiPowerSettings custom_power;
+  // When set, drop to this profile after `idle_after_ms` without a call
+  // to WifiService::note_activity(), and return on the next one.
+  std::optional<WifiPowerProfile> idle_power_profile;
+  uint32_t idle_after_ms = 30000;
 };
 
 enum class WifiMode {
@@ -79,6 +179,16 @@ enum class WifiEvent {
   StateChanged
 };
 
+using WifiEventMask = uint32_t;
+
+constexpr WifiEventMask wifi_event_mask(WifiEvent event) {
+  return WifiEventMask{1} << static_cast<uint32_t>(event);
+}
+constexpr WifiEventMask all_wifi_events = ~WifiEventMask{0};
+
+// Returned by subscribe(); 0 means the subscription was not made.
+using WifiSubscriptionId = uint32_t;
+
 struct WifiEventData {
   WifiEvent event;
   WifiMode mode = WifiMode::Off;
@@ -88,7 +198,31 @@ struct WifiEventData {
   esp_err_t error_code = ESP_OK;
   std::optional<esp_ip4_addr_t> ip_address;
   std::optional<wifi_err_reason_t> disconnect_reason;
-  std::optional<WifiCredentials> credentials;
+  // Shared by every listener that receives the event.
+  std::shared_ptr<const WifiCredentials> credentials;
+  // Connected events only: time from connect() to the IP address, and
+  // whether the cached BSSID/channel got us there.
+  std::optional<uint32_t> time_to_ip_ms;
+  bool fast_connect = false;
+};
+
+// How the station gets back onto the network after losing it or failing to
+// join. The delay doubles with each failed attempt up to max_delay_ms and is
+// spread by +/- jitter_percent so devices behind one AP do not retry in
+// lockstep. Authentication failures wait at least auth_fail_delay_ms, since
+// retrying a wrong password quickly only burns power.
+struct WifiReconnectPolicy {
+#if CONFIG_EARBRAIN_WIFI_RECONNECT
+  bool enabled = true;
+#else
+  bool enabled = false;
+#endif
+  uint32_t initial_delay_ms = CONFIG_EARBRAIN_WIFI_RECONNECT_INITIAL_MS;
+  uint32_t max_delay_ms = CONFIG_EARBRAIN_WIFI_RECONNECT_MAX_MS;
+  uint32_t auth_fail_delay_ms = CONFIG_EARBRAIN_WIFI_RECONNECT_AUTH_FAIL_MS;
+  uint8_t jitter_percent = 20;
+  // 0 keeps retrying forever.
+  uint32_t max_attempts = 0;
 };
 
 struct WifiStatus {
@@ -99,6 +233,62 @@ struct WifiStatus {
   esp_ip4_addr_t sta_ip{};
   wifi_err_reason_t sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
   esp_err_t sta_last_error = ESP_OK;
+  // Failed attempts since the last connection, and automatic attempts
+  // started since boot.
+  uint32_t reconnect_attempts = 0;
+  uint32_t reconnects_total = 0;
+  // Time until the next automatic attempt, when one is scheduled.
+  std::optional<uint32_t> next_reconnect_ms;
+  // Changes whenever any field above does; see status_generation().
+  uint32_t generation = 0;
+};
+
+struct KnownNetwork {
+  std::string ssid;
+  std::string passphrase;
+  // Higher wins when several known networks are in range.
+  uint8_t priority = 0;
+};
+
+// Ranked list of networks the station may join, kept in its own NVS
+// namespace. The list is read from flash once and served from RAM after
+// that; every change is written back with a single commit. Ranking is by
+// priority, then by how recently the network was saved.
+class WifiCredentialStore {
+public:
+  static constexpr std::size_t max_networks = CONFIG_EARBRAIN_WIFI_MAX_NETWORKS;
+
+  WifiCredentialStore() = default;
+
+  WifiCredentialStore(const WifiCredentialStore &) = delete;
+  WifiCredentialStore &operator=(const WifiCredentialStore &) = delete;
+  WifiCredentialStore(WifiCredentialStore &&) = delete;
+  WifiCredentialStore &operator=(WifiCredentialStore &&) = delete;
+
+  std::vector<KnownNetwork> networks() const;
+  std::optional<KnownNetwork> find(std::string_view ssid) const;
+  std::optional<KnownNetwork> top() const;
+  std::size_t size() const;
+
+  // Adds or updates the network with this SSID. When the store is full the
+  // lowest-ranked network makes room; if that would be this one, nothing
+  // changes and ESP_ERR_NO_MEM is returned.
+  esp_err_t save(const KnownNetwork &network);
+  esp_err_t remove(std::string_view ssid);
+  esp_err_t clear();
+
+  // The best known network in `scan`: highest priority first, then the
+  // strongest signal.
+  std::optional<KnownNetwork> best_match(const WifiScanResult &scan) const;
+
+private:
+  void ensure_loaded() const;
+  esp_err_t commit(std::vector<KnownNetwork> next);
+  static esp_err_t persist(const std::vector<KnownNetwork> &networks);
+
+  mutable std::mutex mutex;
+  mutable std::vector<KnownNetwork> entries;
+  mutable bool loaded = false;
 };
 
 class WifiService {
@@ -106,7 +296,7 @@ public:
   using EventListener = std::function<void(const WifiEventData &)>;
 
   WifiService();
-  ~WifiService() = default;
+  ~WifiService();
 
   WifiService(const WifiService &) = delete;
   WifiService &operator=(const WifiService &) = delete;
@@ -122,17 +312,73 @@ public:
 
   esp_err_t connect(const WifiCredentials &creds);
   esp_err_t connect();
-  esp_err_t save_credentials(std::string_view ssid, std::string_view passphrase);
+
+  // Where the driver keeps the station configuration. Set it here rather
+  // than with esp_wifi_set_storage(): fast connects switch to RAM for one
+  // set_config and restore this afterwards.
+  wifi_storage_t storage() const { return driver_storage.load(); }
+  esp_err_t storage(wifi_storage_t storage);
+
+  // Switch power profile while connected, without reconnecting.
+  WifiPowerProfile power_profile() const;
+  esp_err_t power_profile(WifiPowerProfile profile);
+  // Marks traffic for the idle profile switch; cheap enough to call per
+  // request.
+  void note_activity();
+
+  // Resolve with ESP_OK once the station has an IP address, or with the
+  // error that ended the attempt. Chain follow-up steps with then().
+  // Failures the reconnect backoff retries do not end the attempt; giving
+  // up, or cancelling the backoff, does. A later connect() or provisioning
+  // replaces the attempt and resolves its futures with
+  // ESP_ERR_INVALID_STATE. Without credentials an attempt already in
+  // progress is joined, and an existing connection resolves immediately.
+  Future<esp_err_t> connect_async(const WifiCredentials &creds);
+  Future<esp_err_t> connect_async();
+  WifiReconnectPolicy reconnect_policy() const;
+  esp_err_t reconnect_policy(const WifiReconnectPolicy &policy);
+
+  // Saved networks go into the credential store; connect() without
+  // arguments joins the best of them in a fresh cached scan, or the top
+  // ranked one, and the reconnect backoff scans for another when that fails.
+  esp_err_t save_credentials(std::string_view ssid, std::string_view passphrase,
+                             uint8_t priority = 0);
   std::optional<WifiCredentials> load_credentials();
+  esp_err_t forget_credentials(std::string_view ssid);
+  WifiCredentialStore &known_networks() { return credential_store; }
 
   esp_err_t start_provisioning(ProvisionMode mode, const ProvisioningOptions &opts = {});
   esp_err_t cancel_provisioning();
 
   WifiScanResult perform_scan() const;
+  WifiScanResult perform_scan(const WifiScanOptions &options) const;
+  void clear_scan_cache();
+
+  using ScanListener = std::function<void(const WifiScanChunk &)>;
+
+  // Starts a non-blocking scan that writes raw records into `buffer`, which
+  // must stay valid until the returned future resolves. `on_records` runs
+  // on the event loop task as records arrive.
+  Future<WifiScanOutcome> scan_async(std::span<wifi_ap_record_t> buffer,
+                                     ScanListener on_records = {},
+                                     const WifiScanOptions &options = {});
+  // A consistent snapshot; never a mix of two states.
   WifiStatus status() const;
+  // Cheap check for pollers: while this equals the generation of the
+  // last status() they read, nothing has changed.
+  uint32_t status_generation() const;
 
   WifiMode mode() const { return current_mode; }
-  void on(EventListener listener);
+
+  // Listeners run one after another on a dedicated task
+  // (CONFIG_EARBRAIN_WIFI_EVENT_TASK_STACK_SIZE), never on the system event
+  // loop, and only for the events in `events`. A listener removed by
+  // unsubscribe() may still see an event that is already being delivered.
+  WifiSubscriptionId subscribe(EventListener listener,
+                               WifiEventMask events = all_wifi_events);
+  WifiSubscriptionId subscribe(WifiEvent event, EventListener listener);
+  bool unsubscribe(WifiSubscriptionId id);
+  WifiSubscriptionId on(EventListener listener);
 
 private:
   static wifi_mode_t to_native_mode(WifiMode mode);
@@ -147,16 +393,51 @@ private:
                                          int32_t event_id, void *event_data);
   void on_sta_got_ip(const ip_event_got_ip_t &event);
   void on_sta_disconnected(const wifi_event_sta_disconnected_t &event);
+  void on_scan_done(const wifi_event_sta_scan_done_t &event);
+  bool apply_fast_connect(const WifiCredentials &creds, wifi_config_t &sta_cfg);
+  void remember_fast_connect();
+  void update_fast_record(const WifiCredentials &creds, const wifi_ap_record_t &ap);
+  void forget_fast_connect();
+  void load_fast_record();
+  void store_fast_record();
+  esp_err_t start_scan_pass();
+  void finish_scan(esp_err_t error);
   void on_provisioning_done(void *event_data);
+  esp_err_t begin_connect(const WifiCredentials &creds, Future<esp_err_t> *result);
+  esp_err_t begin_connect(Future<esp_err_t> *result);
+  esp_err_t start_connect(const WifiCredentials &creds);
+  WifiPowerSettings power_settings(WifiPowerProfile profile) const;
+  esp_err_t apply_power(WifiPowerProfile profile);
+  void arm_idle_timer();
+  static void on_idle_timer(void *arg);
+  std::optional<WifiCredentials> pick_network();
+  std::optional<WifiScanResult> fresh_scan() const;
+  void run_reconnect(uint32_t generation);
+  void roam(uint32_t generation);
+  void finish_roam(const WifiScanOutcome &outcome);
+  void retry_connect(uint32_t generation, uint32_t attempt, const WifiCredentials &creds);
+  bool schedule_reconnect(wifi_err_reason_t reason, uint32_t generation);
+  void cancel_reconnect();
+  static void on_reconnect_timer(void *arg);
 
+  bool wants(WifiEvent event) const;
+  template <typename F>
+  void update_status(F &&mutate);
   void emit(const WifiEventData &data) const;
+  void deliver(const WifiEventData &data) const;
+  void start_event_task();
+  static void event_task(void *arg);
   void emit_connection_failed(esp_err_t error);
+  uint32_t begin_attempt();
+  Future<esp_err_t> track_connect(uint32_t attempt);
+  void settle_connects(uint32_t attempt, esp_err_t result);
 
   esp_netif_obj *softap_netif;
   esp_netif_obj *sta_netif;
   WifiConfig wifi_config;
   WifiCredentials credentials;
-  std::optional<WifiCredentials> cached_credentials;
+  WifiCredentialStore credential_store;
+  bool driver_credentials_imported = false;
   std::optional<WifiCredentials> temp_provisioning_credentials;
   bool initialized;
   bool handlers_registered;
@@ -170,7 +451,100 @@ private:
 
   WifiMode current_mode;
   ProvisionMode current_provisioning_mode;
-  std::vector<EventListener> listeners;
+
+  struct Subscription {
+    WifiSubscriptionId id;
+    WifiEventMask events;
+    EventListener listener;
+  };
+  using SubscriptionList = std::vector<Subscription, TrackedAllocator<Subscription, MemoryTag::Wifi>>;
+  struct EventDispatch;
+
+  // Replaced, never modified, so delivery can walk it without the lock.
+  mutable std::mutex listeners_mutex;
+  std::shared_ptr<const SubscriptionList> listeners;
+  std::atomic<WifiEventMask> subscribed_events{0};
+  WifiSubscriptionId next_subscription_id = 1;
+  std::unique_ptr<EventDispatch> event_dispatch;
+  // Each connect() or provisioning run is one attempt, however many
+  // reconnects it takes; futures only settle with their own attempt.
+  struct PendingConnect {
+    uint32_t attempt;
+    Promise<esp_err_t> promise;
+  };
+  std::atomic<uint32_t> connect_attempt{0};
+  std::mutex pending_connects_mutex;
+  std::vector<PendingConnect> pending_connects;
+
+  struct ScanJob {
+    std::span<wifi_ap_record_t> buffer;
+    ScanListener on_records;
+    WifiScanOptions options;
+    uint16_t used = 0;
+    // Channel of the pass in flight (0 = all) and the ones still to do.
+    uint8_t channel = 0;
+    uint16_t remaining = 0;
+    bool truncated = false;
+    Promise<WifiScanOutcome> promise;
+  };
+  // Last successful association, kept in NVS so the next connect can skip
+  // the all-channel scan and the PMK derivation.
+  struct FastConnect {
+    uint8_t version = 1;
+    char ssid[33] = {};
+    uint32_t passphrase_hash = 0;
+    uint8_t bssid[6] = {};
+    uint8_t channel = 0;
+    wifi_auth_mode_t auth_mode = WIFI_AUTH_OPEN;
+    bool has_pmk = false;
+    uint8_t pmk[32] = {};
+  };
+  std::mutex fast_connect_mutex;
+  std::optional<FastConnect> fast_record;
+  bool fast_record_loaded = false;
+  std::atomic<bool> fast_attempt{false};
+  std::atomic<int64_t> connect_started_us{0};
+  std::atomic<wifi_storage_t> driver_storage{WIFI_STORAGE_FLASH};
+  // When the current attempt associated; only kept for tracing.
+  std::atomic<int64_t> associated_us{0};
+
+  struct StatusSnapshot {
+    WifiStatus status;
+    int64_t reconnect_due_us = 0;
+  };
+  Seqlock<StatusSnapshot> published_status;
+
+  mutable std::mutex power_mutex;
+  std::atomic<uint16_t> sta_listen_interval{
+      wifi_power_settings(default_wifi_power_profile).listen_interval};
+  std::atomic<bool> power_idle{false};
+  std::atomic<int64_t> last_activity_us{0};
+  esp_timer_handle_t idle_timer = nullptr;
+
+  mutable std::mutex reconnect_mutex;
+  WifiReconnectPolicy reconnect_settings;
+  esp_timer_handle_t reconnect_timer = nullptr;
+  std::atomic<uint32_t> reconnect_attempt{0};
+  std::atomic<uint32_t> reconnect_total{0};
+  std::atomic<int64_t> reconnect_due_us{0};
+  // Bumped by cancel_reconnect(), so a backoff step that was decided
+  // before an explicit connect or mode change is dropped.
+  std::atomic<uint32_t> reconnect_generation{0};
+
+  struct CachedScan {
+    WifiScanOptions options;
+    WifiScanResult result;
+    int64_t taken_us = 0;
+  };
+  // perform_scan() is const but claims the radio and fills the cache.
+  mutable std::mutex scan_mutex;
+  std::optional<ScanJob> scan_job;
+  mutable bool blocking_scan = false;
+  mutable std::optional<CachedScan> scan_cache;
+  // Buffer of the reconnect backoff's roaming scan, only held while it runs.
+  std::atomic<bool> roam_scanning{false};
+  std::atomic<uint32_t> roam_generation{0};
+  std::vector<wifi_ap_record_t, TrackedAllocator<wifi_ap_record_t, MemoryTag::Wifi>> roam_records;
 };
 
 WifiService &wifi();
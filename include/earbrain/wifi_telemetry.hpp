@@ -0,0 +1,105 @@
+#pragma once
+
+#include "earbrain/time_series.hpp"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_wifi_types.h"
+#include "sdkconfig.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+namespace earbrain {
+
+struct WifiEventData;
+
+enum class WifiPhy : uint8_t {
+  Unknown,
+  B,
+  G,
+  N,
+  AX,
+  LR
+};
+
+// One telemetry sample of the station link. Counters are cumulative since
+// the sampler started and wrap at 32 bits; the per-second rates cover the
+// interval since the previous sample.
+struct WifiLinkSample {
+  uint32_t timestamp_ms;
+  bool associated;
+  int8_t rssi;
+  uint8_t channel;
+  WifiPhy phy;
+  uint32_t rx_bytes;
+  uint32_t tx_bytes;
+  uint32_t rx_packets;
+  uint32_t tx_packets;
+  uint32_t rx_bytes_per_s;
+  uint32_t tx_bytes_per_s;
+  uint32_t reconnects_total;
+};
+
+struct WifiDisconnectRecord {
+  uint32_t timestamp_ms;
+  wifi_err_reason_t reason;
+  // RSSI of the last sample before the drop.
+  int8_t rssi;
+  // How long the link had been up; 0 when it never came up.
+  uint32_t connected_ms;
+};
+
+// Samples the station link on an esp_timer without scanning: RSSI, channel
+// and PHY come from the current association, byte and packet counts from a
+// hook on the STA netif. Disconnects are recorded as they are reported.
+// Everything is kept in preallocated rings, so a running sampler never
+// allocates.
+class WifiTelemetry {
+public:
+  static constexpr uint32_t default_period_ms = CONFIG_EARBRAIN_WIFI_TELEMETRY_PERIOD_MS;
+
+  WifiTelemetry() = default;
+  ~WifiTelemetry();
+
+  WifiTelemetry(const WifiTelemetry &) = delete;
+  WifiTelemetry &operator=(const WifiTelemetry &) = delete;
+  WifiTelemetry(WifiTelemetry &&) = delete;
+  WifiTelemetry &operator=(WifiTelemetry &&) = delete;
+
+  esp_err_t start(uint32_t period_ms = default_period_ms);
+  esp_err_t stop();
+  bool is_running() const noexcept { return running; }
+  uint32_t period_ms() const noexcept { return period; }
+
+  // Takes one sample immediately; the timer calls this every period.
+  void sample();
+
+  std::optional<WifiLinkSample> latest() const;
+  SeriesBatch<WifiLinkSample> collect(uint64_t cursor, std::size_t limit) const;
+  SeriesBatch<WifiDisconnectRecord> disconnects(uint64_t cursor, std::size_t limit) const;
+  void clear();
+
+private:
+  using SampleSeries = TimeSeries<WifiLinkSample, CONFIG_EARBRAIN_WIFI_TELEMETRY_SAMPLES>;
+  using DisconnectSeries =
+      TimeSeries<WifiDisconnectRecord, CONFIG_EARBRAIN_WIFI_TELEMETRY_DISCONNECTS>;
+
+  static void on_timer(void *arg);
+  void on_event(const WifiEventData &event);
+
+  mutable std::mutex mutex;
+  esp_timer_handle_t timer = nullptr;
+  uint32_t period = 0;
+  bool running = false;
+  uint32_t subscription = 0;
+
+  SampleSeries samples;
+  DisconnectSeries disconnect_history;
+  int64_t connected_since_us = 0;
+};
+
+WifiTelemetry &wifi_telemetry();
+
+} // namespace earbrain
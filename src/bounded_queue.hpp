@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace earbrain::detail {
+
+// Bounded lock-free queue (Vyukov). Any number of tasks may push and pop;
+// elements are filled and consumed in place so slots never need to be copied.
+template <typename T, std::size_t Capacity>
+class BoundedQueue {
+  static_assert(Capacity >= 2 && std::has_single_bit(Capacity),
+                "BoundedQueue capacity must be a power of two");
+
+public:
+  BoundedQueue() : enqueue_pos(0), dequeue_pos(0) {
+    for (std::size_t i = 0; i < Capacity; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  template <typename Fill>
+  bool try_push(Fill &&fill) {
+    Cell *cell = nullptr;
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & (Capacity - 1)];
+      const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(sequence) -
+                        static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+
+    fill(cell->value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename Consume>
+  bool try_pop(Consume &&consume) {
+    Cell *cell = nullptr;
+    std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & (Capacity - 1)];
+      const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(sequence) -
+                        static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+
+    consume(cell->value);
+    cell->sequence.store(pos + Capacity, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return dequeue_pos.load(std::memory_order_acquire) ==
+           enqueue_pos.load(std::memory_order_acquire);
+  }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  Cell cells[Capacity];
+  std::atomic<std::size_t> enqueue_pos;
+  std::atomic<std::size_t> dequeue_pos;
+};
+
+} // namespace earbrain::detail
@@ -1,103 +1,820 @@
 #include "earbrain/logging.hpp"
+#include "earbrain/task_helpers.hpp"
+#include "earbrain/trace.hpp"
+
+#include "bounded_queue.hpp"
+#include "freertos/task.h"
 
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <string>
 #include <string_view>
 #include <utility>
-#include <vector>
+
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+#include "esp_app_desc.h"
+#include "esp_attr.h"
+#endif
+// The linux target has no capabilities allocator; the arena comes from
+// malloc there.
+#if CONFIG_IDF_TARGET_LINUX
+#include <cstdlib>
+#else
+#include "esp_heap_caps.h"
+#endif
 
 namespace earbrain::logging {
 
 namespace {
 
-std::string normalise_tag(std::string_view tag) {
-  if (tag.empty()) {
-    return std::string(Logger::default_tag());
+// Formatting happens in this stack buffer; only longer messages fall back to
+// a heap allocation.
+constexpr std::size_t format_buffer_size = CONFIG_EARBRAIN_LOG_FORMAT_BUFFER_SIZE;
+constexpr std::size_t console_tag_size = 32;
+
+std::string_view normalise_tag(std::string_view tag) {
+  return tag.empty() ? Logger::default_tag() : tag;
+}
+
+std::string_view tag_or_default(const char *tag) {
+  return tag ? std::string_view{tag} : Logger::default_tag();
+}
+
+constexpr std::size_t tag_level_slots = CONFIG_EARBRAIN_LOG_TAG_LEVEL_SLOTS;
+constexpr std::size_t tag_level_name_size = 24;
+
+struct TagLevel {
+  char tag[tag_level_name_size];
+  uint8_t tag_len;
+  std::atomic<esp_log_level_t> level;
+};
+
+// Readers never lock: entries are only appended, and an entry is published by
+// bumping `count` after its tag has been written.
+struct LevelTable {
+  TagLevel entries[tag_level_slots];
+  std::atomic<std::size_t> count{0};
+  std::atomic<esp_log_level_t> default_level{ESP_LOG_VERBOSE};
+  std::mutex mutex;
+};
+
+LevelTable &level_table() {
+  static LevelTable table;
+  return table;
+}
+
+TagLevel *find_tag_level(LevelTable &table, std::string_view tag) {
+  const std::size_t count = table.count.load(std::memory_order_acquire);
+  for (std::size_t i = 0; i < count; ++i) {
+    TagLevel &entry = table.entries[i];
+    if (entry.tag_len == tag.size() &&
+        std::memcmp(entry.tag, tag.data(), tag.size()) == 0) {
+      return &entry;
+    }
   }
-  return std::string(tag);
+  return nullptr;
 }
 
-std::string format_message(const char *format, va_list args) {
-  if (!format) {
-    return {};
+void write_console(esp_log_level_t level, const char *tag,
+                   std::string_view message) {
+  const int length = static_cast<int>(message.size());
+  if (message.empty() || message.back() != '\n') {
+    esp_log_write(level, tag, "%.*s\n", length, message.data());
+  } else {
+    esp_log_write(level, tag, "%.*s", length, message.data());
   }
+}
 
-  va_list copy;
-  va_copy(copy, args);
-  const int required = vsnprintf(nullptr, 0, format, copy);
-  va_end(copy);
-  if (required <= 0) {
+void write_console(esp_log_level_t level, std::string_view tag,
+                   std::string_view message) {
+  // esp_log_write wants a NUL-terminated tag.
+  char console_tag[console_tag_size];
+  const std::size_t tag_len = std::min(tag.size(), sizeof(console_tag) - 1);
+  std::memcpy(console_tag, tag.data(), tag_len);
+  console_tag[tag_len] = '\0';
+  write_console(level, console_tag, message);
+}
+
+std::string_view render(const DeferredRecord &record, char *buffer,
+                        std::size_t size) {
+  const int length = record.render(buffer, size);
+  if (length <= 0) {
     return {};
   }
+  return std::string_view(buffer, std::min(static_cast<std::size_t>(length), size - 1));
+}
+
+#if CONFIG_EARBRAIN_LOG_ASYNC
+
+constexpr std::size_t async_queue_length =
+    std::bit_floor<std::size_t>(CONFIG_EARBRAIN_LOG_ASYNC_QUEUE_LENGTH);
+constexpr std::size_t async_tag_size = 24;
+
+constexpr OverflowPolicy default_overflow_policy =
+#if CONFIG_EARBRAIN_LOG_ASYNC_DROP_OLDEST
+    OverflowPolicy::DropOldest;
+#elif CONFIG_EARBRAIN_LOG_ASYNC_BLOCK
+    OverflowPolicy::Block;
+#else
+    OverflowPolicy::DropNewest;
+#endif
+
+struct QueuedRecord {
+  uint32_t timestamp_ms;
+  esp_log_level_t level;
+  uint16_t message_len;
+  // `message` holds a DeferredRecord rather than text.
+  bool deferred;
+  char tag[async_tag_size];
+  char message[CONFIG_EARBRAIN_LOG_ASYNC_MESSAGE_SIZE];
+};
+
+struct AsyncState {
+  earbrain::detail::BoundedQueue<QueuedRecord, async_queue_length> queue;
+  std::atomic<TaskHandle_t> drain_task{nullptr};
+  std::atomic<bool> drain_sleeping{false};
+  std::atomic<bool> drain_busy{false};
+  std::atomic<bool> available{false};
+  std::atomic<OverflowPolicy> policy{default_overflow_policy};
+  std::atomic<uint32_t> block_timeout_ms{CONFIG_EARBRAIN_LOG_ASYNC_BLOCK_TIMEOUT_MS};
+  std::atomic<uint32_t> dropped{0};
+};
+
+AsyncState &async_state() {
+  static AsyncState state;
+  return state;
+}
+
+#endif
+
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA
+
+// Fixed header in front of every arena record. `size` is the exact record
+// length (records start on arena_alignment boundaries); the level shares a
+// byte with the record kind, leaving the timestamp its full 32 bits, the
+// same ~49.7 day range as esp_log_timestamp(). An inline tag is stored as a
+// length byte plus the tag bytes, then the body follows: message text, or the
+// format function, format string and packed arguments of a deferred record.
+struct ArenaRecord {
+  uint16_t size;
+  uint8_t tag_id;
+  uint8_t kind_level;
+  uint32_t timestamp_ms;
+};
+
+constexpr uint8_t record_text = 0;
+constexpr uint8_t record_deferred = 1;
+constexpr uint8_t inline_tag_id = UINT8_MAX;
+
+constexpr unsigned kind_level_shift = 4;
+constexpr uint8_t kind_mask = (1u << kind_level_shift) - 1;
+
+constexpr std::size_t arena_alignment = LogStore::arena_alignment;
+constexpr std::size_t arena_max_record = 0xFFFF & ~(arena_alignment - 1);
+constexpr std::size_t arena_bytes = LogStore::arena_size & ~(arena_alignment - 1);
+
+static_assert(LogStore::arena_tag_slots < inline_tag_id,
+              "tag id 255 is reserved for inline tags");
+
+constexpr std::size_t align_record(std::size_t size) {
+  return (size + arena_alignment - 1) & ~(arena_alignment - 1);
+}
+
+ArenaRecord read_record(const uint8_t *arena, std::size_t offset) {
+  ArenaRecord record;
+  std::memcpy(&record, arena + offset, sizeof(record));
+  return record;
+}
+
+constexpr std::size_t deferred_header_size =
+    sizeof(DeferredRecord::FormatFn) + sizeof(const char *);
+
+std::size_t pack_deferred(const DeferredRecord &record, uint8_t *out) {
+  std::memcpy(out, &record.format_fn, sizeof(record.format_fn));
+  std::memcpy(out + sizeof(record.format_fn), &record.format, sizeof(record.format));
+  std::memcpy(out + deferred_header_size, record.args, record.args_size);
+  return deferred_header_size + record.args_size;
+}
+
+DeferredRecord unpack_deferred(const uint8_t *data, std::size_t size) {
+  DeferredRecord record;
+  if (size < deferred_header_size ||
+      size - deferred_header_size > DeferredRecord::args_capacity) {
+    return record;
+  }
+  std::memcpy(&record.format_fn, data, sizeof(record.format_fn));
+  std::memcpy(&record.format, data + sizeof(record.format_fn), sizeof(record.format));
+  record.args_size = static_cast<uint8_t>(size - deferred_header_size);
+  std::memcpy(record.args, data + deferred_header_size, record.args_size);
+  return record;
+}
+
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST_RTC
+#define EARBRAIN_LOG_PERSIST_ATTR RTC_NOINIT_ATTR
+#else
+#define EARBRAIN_LOG_PERSIST_ATTR __NOINIT_ATTR
+#endif
+
+constexpr uint32_t persist_magic = 0x4C4F4732; // "LOG2"
+constexpr std::size_t persist_image_size = 17;
+
+struct PersistedTag {
+  char name[LogStore::arena_tag_name_size];
+  uint8_t len;
+};
+
+// Lives in memory that is not cleared on reset. The ring state is rewritten
+// after every change and covered by `check`, so a reset in the middle of an
+// update is detected at boot instead of yielding a corrupt ring.
+struct PersistedArena {
+  uint32_t magic;
+  uint32_t capacity;
+  uint32_t tag_slots;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t wrap;
+  uint32_t count;
+  uint32_t tag_count;
+  uint64_t next_id;
+  uint64_t boot_id;
+  uint32_t check;
+  char image[persist_image_size];
+  PersistedTag tags[LogStore::arena_tag_slots];
+  alignas(LogStore::arena_alignment) uint8_t data[arena_bytes];
+};
+
+EARBRAIN_LOG_PERSIST_ATTR PersistedArena persisted_arena;
+
+uint32_t persist_check(const PersistedArena &block) {
+  const uint32_t words[] = {
+      block.head, block.tail, block.wrap, block.count, block.tag_count,
+      static_cast<uint32_t>(block.next_id), static_cast<uint32_t>(block.next_id >> 32),
+      static_cast<uint32_t>(block.boot_id)};
+  uint32_t check = persist_magic;
+  for (const uint32_t word : words) {
+    check = std::rotl(check, 5) ^ word;
+    check *= 0x9E3779B1u;
+  }
+  return check;
+}
+
+void current_image(char (&image)[persist_image_size]) {
+  std::memset(image, 0, sizeof(image));
+  esp_app_get_elf_sha256(image, sizeof(image));
+}
+
+#endif
+
+uint8_t *allocate_arena(std::size_t size) {
+  void *memory = nullptr;
+#if CONFIG_IDF_TARGET_LINUX
+  memory = std::malloc(size);
+#else
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PSRAM
+  memory = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+  if (!memory) {
+    memory = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+#endif
+  if (memory) {
+    earbrain::detail::note_allocation(MemoryTag::Logging, size);
+  }
+  return static_cast<uint8_t *>(memory);
+}
+
+void free_arena(void *memory, std::size_t size) {
+  if (memory) {
+    earbrain::detail::note_deallocation(MemoryTag::Logging, size);
+#if CONFIG_IDF_TARGET_LINUX
+    std::free(memory);
+#else
+    heap_caps_free(memory);
+#endif
+  }
+}
+
+#endif
+
+} // namespace
+
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA
+
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+
+// Only the index is allocated; it is rebuilt from the persistent records.
+LogStore::LogStore()
+    : arena(persisted_arena.data),
+      arena_index(reinterpret_cast<ArenaSlot *>(
+          allocate_arena(arena_index_capacity * sizeof(ArenaSlot)))),
+      arena_capacity(arena_index ? arena_bytes : 0),
+      arena_head(0), arena_tail(0), arena_wrap(arena_capacity),
+      arena_count(0), arena_boot_id(0), arena_recovered(0),
+      arena_foreign_image(false), arena_tags(), arena_tag_count(0),
+      next_id(0) {
+  if (arena_index && !arena_recover()) {
+    PersistedArena &block = persisted_arena;
+    block.magic = persist_magic;
+    block.capacity = arena_bytes;
+    block.tag_slots = arena_tag_slots;
+    current_image(block.image);
+    arena_persist();
+  }
+}
+
+LogStore::~LogStore() { free_arena(arena_index, arena_index_capacity * sizeof(ArenaSlot)); }
+
+#else
+
+LogStore::LogStore()
+    : arena(allocate_arena(arena_bytes + arena_index_capacity * sizeof(ArenaSlot))),
+      arena_index(arena ? reinterpret_cast<ArenaSlot *>(arena + arena_bytes) : nullptr),
+      arena_capacity(arena ? arena_bytes : 0),
+      arena_head(0), arena_tail(0), arena_wrap(arena_capacity),
+      arena_count(0), arena_boot_id(0), arena_tags(), arena_tag_count(0),
+      next_id(0) {}
+
+LogStore::~LogStore() {
+  free_arena(arena, arena_bytes + arena_index_capacity * sizeof(ArenaSlot));
+}
+
+#endif
+
+void LogStore::log(esp_log_level_t level, std::string_view tag,
+                   std::string_view message) {
+  log(level, tag, message, esp_log_timestamp());
+}
+
+void LogStore::log(esp_log_level_t level, std::string_view tag,
+                   std::string_view message, uint32_t timestamp_ms) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!arena_index) {
+    return;
+  }
+  arena_push(timestamp_ms, level, tag, record_text, message);
+}
+
+void LogStore::log(esp_log_level_t level, std::string_view tag,
+                   const DeferredRecord &record) {
+  log(level, tag, record, esp_log_timestamp());
+}
+
+void LogStore::log(esp_log_level_t level, std::string_view tag,
+                   const DeferredRecord &record, uint32_t timestamp_ms) {
+  uint8_t body[deferred_header_size + DeferredRecord::args_capacity];
+  const std::size_t size = pack_deferred(record, body);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!arena_index) {
+    return;
+  }
+  arena_push(timestamp_ms, level, tag, record_deferred,
+             std::string_view(reinterpret_cast<const char *>(body), size));
+}
+
+uint8_t LogStore::arena_intern(std::string_view tag) {
+  for (std::size_t i = 0; i < arena_tag_count; ++i) {
+    const ArenaTag &entry = arena_tags[i];
+    if (entry.len == tag.size() && std::memcmp(entry.name, tag.data(), tag.size()) == 0) {
+      return static_cast<uint8_t>(i);
+    }
+  }
+  if (arena_tag_count >= arena_tag_slots || tag.size() > arena_tag_name_size) {
+    return inline_tag_id;
+  }
+
+  ArenaTag &entry = arena_tags[arena_tag_count];
+  std::memcpy(entry.name, tag.data(), tag.size());
+  entry.len = static_cast<uint8_t>(tag.size());
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+  PersistedTag &persisted = persisted_arena.tags[arena_tag_count];
+  std::memcpy(persisted.name, entry.name, sizeof(persisted.name));
+  persisted.len = entry.len;
+#endif
+  return static_cast<uint8_t>(arena_tag_count++);
+}
+
+void LogStore::arena_push(uint32_t timestamp_ms, esp_log_level_t level,
+                          std::string_view tag, uint8_t kind,
+                          std::string_view body) {
+  const std::size_t max_record = std::min(arena_capacity, arena_max_record);
+  tag = tag.substr(0, UINT8_MAX);
+  const uint8_t tag_id = arena_intern(tag);
+  const std::size_t prefix =
+      sizeof(ArenaRecord) + (tag_id == inline_tag_id ? 1 + tag.size() : 0);
+  if (prefix > max_record) {
+    return;
+  }
+  if (kind == record_text) {
+    body = body.substr(0, max_record - prefix);
+  } else if (prefix + body.size() > max_record) {
+    return;
+  }
+  const std::size_t exact_size = prefix + body.size();
+  const std::size_t size = align_record(exact_size);
+
+  while (arena_count >= arena_index_capacity) {
+    arena_evict();
+  }
+
+  if (arena_count == 0) {
+    arena_head = 0;
+    arena_tail = 0;
+    arena_wrap = arena_capacity;
+  }
+
+  if (arena_tail + size > arena_capacity) {
+    // Drop everything stored behind the tail, then restart at offset 0.
+    while (arena_count > 0 && arena_head >= arena_tail) {
+      arena_evict();
+    }
+    arena_wrap = arena_tail;
+    arena_tail = 0;
+  }
+
+  while (arena_count > 0 && arena_head >= arena_tail &&
+         arena_head < arena_tail + size) {
+    arena_evict();
+  }
+
+  if (arena_count == 0) {
+    arena_head = arena_tail;
+    arena_wrap = arena_capacity;
+  }
+
+  // Persist the evictions before their bytes are overwritten.
+  arena_persist();
+
+  ArenaRecord record{};
+  record.size = static_cast<uint16_t>(exact_size);
+  record.tag_id = tag_id;
+  record.kind_level = static_cast<uint8_t>((level << kind_level_shift) | kind);
+  record.timestamp_ms = timestamp_ms;
+
+  uint8_t *destination = arena + arena_tail;
+  std::memcpy(destination, &record, sizeof(record));
+  destination += sizeof(record);
+  if (tag_id == inline_tag_id) {
+    *destination++ = static_cast<uint8_t>(tag.size());
+    std::memcpy(destination, tag.data(), tag.size());
+    destination += tag.size();
+  }
+  std::memcpy(destination, body.data(), body.size());
+
+  arena_index[next_id % arena_index_capacity] =
+      static_cast<ArenaSlot>(arena_tail / arena_alignment);
+  ++next_id;
+  arena_tail += size;
+  ++arena_count;
+  arena_persist();
+}
+
+std::size_t LogStore::arena_offset(uint64_t id) const {
+  return static_cast<std::size_t>(arena_index[id % arena_index_capacity]) *
+         arena_alignment;
+}
+
+void LogStore::arena_evict() {
+  const ArenaRecord record = read_record(arena, arena_head);
+  arena_head += align_record(record.size);
+  --arena_count;
+  if (arena_head >= arena_wrap) {
+    arena_head = 0;
+    arena_wrap = arena_capacity;
+  }
+}
+
+std::size_t LogStore::stored() const { return arena_count; }
+
+LogView LogStore::view(uint64_t id) const {
+  const std::size_t offset = arena_offset(id);
+  const ArenaRecord record = read_record(arena, offset);
+  const uint8_t *payload = arena + offset + sizeof(ArenaRecord);
+  std::size_t body_size = record.size - sizeof(ArenaRecord);
+
+  LogView view;
+  view.id = id;
+  view.timestamp_ms = record.timestamp_ms;
+  view.level = static_cast<esp_log_level_t>(record.kind_level >> kind_level_shift);
+
+  if (record.tag_id == inline_tag_id) {
+    const std::size_t tag_len = payload[0];
+    view.tag = std::string_view(reinterpret_cast<const char *>(payload + 1), tag_len);
+    payload += 1 + tag_len;
+    body_size -= 1 + tag_len;
+  } else {
+    const ArenaTag &tag = arena_tags[record.tag_id];
+    view.tag = std::string_view(tag.name, tag.len);
+  }
+
+  if ((record.kind_level & kind_mask) == record_deferred) {
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+    if (arena_foreign_image && id < arena_boot_id) {
+      view.message = "<deferred record from another firmware>";
+      return view;
+    }
+#endif
+    view.message = render(unpack_deferred(payload, body_size), arena_scratch,
+                          sizeof(arena_scratch));
+  } else {
+    view.message = std::string_view(reinterpret_cast<const char *>(payload), body_size);
+  }
+  return view;
+}
+
+void LogStore::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  arena_head = 0;
+  arena_tail = 0;
+  arena_wrap = arena_capacity;
+  arena_count = 0;
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+  arena_recovered = 0;
+#endif
+  arena_persist();
+}
+
+#if CONFIG_EARBRAIN_LOG_STORE_ARENA_PERSIST
+
+std::size_t LogStore::recovered() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::min(arena_recovered, arena_count);
+}
+
+void LogStore::arena_persist() {
+  PersistedArena &block = persisted_arena;
+  block.head = static_cast<uint32_t>(arena_head);
+  block.tail = static_cast<uint32_t>(arena_tail);
+  block.wrap = static_cast<uint32_t>(arena_wrap);
+  block.count = static_cast<uint32_t>(arena_count);
+  block.tag_count = static_cast<uint32_t>(arena_tag_count);
+  block.next_id = next_id;
+  block.boot_id = arena_boot_id;
+  block.check = persist_check(block);
+  // Keep the compiler from sinking these stores past the record writes.
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+// Walks the record headers once to validate the ring and rebuild the index;
+// record payloads are left untouched.
+bool LogStore::arena_recover() {
+  const PersistedArena &block = persisted_arena;
+  if (block.magic != persist_magic || block.capacity != arena_bytes ||
+      block.tag_slots != arena_tag_slots || block.check != persist_check(block)) {
+    return false;
+  }
+  if (block.count > arena_index_capacity || block.tag_count > arena_tag_slots ||
+      block.wrap > arena_bytes || block.tail > arena_bytes ||
+      block.next_id < block.count) {
+    return false;
+  }
+
+  const uint64_t first_id = block.next_id - block.count;
+  std::size_t position = block.head;
+  std::size_t limit = block.wrap;
+  for (std::size_t i = 0; i < block.count; ++i) {
+    if (position >= limit) {
+      position = 0;
+      limit = arena_bytes;
+    }
+    if (position % arena_alignment != 0 || position + sizeof(ArenaRecord) > limit) {
+      return false;
+    }
+    const ArenaRecord record = read_record(arena, position);
+    if (record.size < sizeof(ArenaRecord) || position + record.size > limit ||
+        (record.kind_level & kind_mask) > record_deferred ||
+        (record.tag_id != inline_tag_id && record.tag_id >= block.tag_count) ||
+        (record.kind_level >> kind_level_shift) > ESP_LOG_VERBOSE) {
+      return false;
+    }
+    arena_index[(first_id + i) % arena_index_capacity] =
+        static_cast<ArenaSlot>(position / arena_alignment);
+    position += align_record(record.size);
+  }
+  // A push persists its evictions before writing, so a reset in between
+  // leaves the tail already moved back to the start while the newest
+  // record still ends at the wrap point.
+  if (position == limit && limit == block.wrap && block.tail == 0) {
+    position = 0;
+  }
+  if (block.count > 0 && position != block.tail) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < block.tag_count; ++i) {
+    if (block.tags[i].len > arena_tag_name_size) {
+      return false;
+    }
+    std::memcpy(arena_tags[i].name, block.tags[i].name, sizeof(arena_tags[i].name));
+    arena_tags[i].len = block.tags[i].len;
+  }
+
+  arena_head = block.head;
+  arena_tail = block.tail;
+  arena_wrap = block.wrap;
+  arena_count = block.count;
+  arena_tag_count = block.tag_count;
+  next_id = block.next_id;
+  // Only the image of the boot that was cut short is known, so only its
+  // deferred records can be checked; keep just the entries of that boot.
+  if (block.next_id > block.boot_id) {
+    while (arena_count > 0 && next_id - arena_count < block.boot_id) {
+      arena_evict();
+    }
+  }
+  arena_boot_id = next_id;
+  arena_recovered = arena_count;
 
-  std::vector<char> buffer(static_cast<std::size_t>(required) + 1);
-  va_list second;
-  va_copy(second, args);
-  vsnprintf(buffer.data(), buffer.size(), format, second);
-  va_end(second);
-  return std::string(buffer.data(), static_cast<std::size_t>(required));
+  char image[persist_image_size];
+  current_image(image);
+  arena_foreign_image = std::memcmp(image, block.image, sizeof(image)) != 0;
+  std::memcpy(persisted_arena.image, image, sizeof(image));
+  arena_persist();
+  return true;
+}
+
+#else
+
+std::size_t LogStore::recovered() const { return 0; }
+
+void LogStore::arena_persist() {}
+
+#endif
+
+#else
+
+namespace {
+
+// The deque's own blocks go through its allocator; the strings of an entry
+// are charged here. Short strings stay in their small buffer and cost
+// nothing.
+void note_strings(const LogEntry &entry, bool stored) {
+  if constexpr (memory_tracking_enabled) {
+    const std::size_t inline_capacity = std::string().capacity();
+    for (const std::string *text : {&entry.tag, &entry.message}) {
+      if (text->capacity() <= inline_capacity) {
+        continue;
+      }
+      if (stored) {
+        earbrain::detail::note_allocation(MemoryTag::Logging, text->capacity() + 1);
+      } else {
+        earbrain::detail::note_deallocation(MemoryTag::Logging, text->capacity() + 1);
+      }
+    }
+  }
 }
 
 } // namespace
 
 LogStore::LogStore() : entries(), next_id(0) {}
 
+LogStore::~LogStore() = default;
+
 void LogStore::log(esp_log_level_t level, std::string_view tag,
-                   std::string message) {
-  const uint32_t timestamp_ms = esp_log_timestamp();
+                   std::string_view message) {
+  log(level, tag, message, esp_log_timestamp());
+}
 
+void LogStore::log(esp_log_level_t level, std::string_view tag,
+                   std::string_view message, uint32_t timestamp_ms) {
   std::lock_guard<std::mutex> lock(mutex);
   LogEntry entry;
   entry.id = next_id++;
   entry.timestamp_ms = timestamp_ms;
   entry.level = level;
   entry.tag = std::string(tag);
-  entry.message = std::move(message);
+  entry.message = std::string(message);
+  note_strings(entry, true);
   entries.push_back(std::move(entry));
   if (entries.size() > max_entries) {
+    note_strings(entries.front(), false);
     entries.pop_front();
   }
 }
 
+void LogStore::log(esp_log_level_t level, std::string_view tag,
+                   const DeferredRecord &record) {
+  log(level, tag, record, esp_log_timestamp());
+}
+
+void LogStore::log(esp_log_level_t level, std::string_view tag,
+                   const DeferredRecord &record, uint32_t timestamp_ms) {
+  char buffer[format_buffer_size];
+  log(level, tag, render(record, buffer, sizeof(buffer)), timestamp_ms);
+}
+
+std::size_t LogStore::stored() const { return entries.size(); }
+
+LogView LogStore::view(uint64_t id) const {
+  const LogEntry &entry = entries[static_cast<std::size_t>(id - entries.front().id)];
+
+  LogView view;
+  view.id = entry.id;
+  view.timestamp_ms = entry.timestamp_ms;
+  view.level = entry.level;
+  view.tag = entry.tag;
+  view.message = entry.message;
+  return view;
+}
+
+void LogStore::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const LogEntry &entry : entries) {
+    note_strings(entry, false);
+  }
+  entries.clear();
+}
+
+std::size_t LogStore::recovered() const { return 0; }
+
+#endif
+
+// Ids are contiguous from the oldest stored entry, so the first entry after a
+// cursor is found by arithmetic rather than by walking the store.
+uint64_t LogStore::first_after(uint64_t cursor) const {
+  const uint64_t oldest_id = next_id - stored();
+  return cursor > 0 ? std::max(cursor + 1, oldest_id) : oldest_id;
+}
+
 LogBatch LogStore::collect(uint64_t cursor, std::size_t limit) const {
   LogBatch batch;
   const std::size_t effective_limit =
       std::clamp<std::size_t>(limit, std::size_t{1}, max_entries);
 
   std::lock_guard<std::mutex> lock(mutex);
-  if (entries.empty()) {
+  if (stored() == 0) {
     batch.next_cursor = cursor;
     batch.has_more = false;
     return batch;
   }
 
-  batch.entries.reserve(std::min(effective_limit, entries.size()));
-  const bool skip_by_cursor = cursor > 0;
+  const uint64_t first_id = first_after(cursor);
+  const std::size_t available =
+      first_id < next_id ? static_cast<std::size_t>(next_id - first_id) : 0;
+  const std::size_t count = std::min(available, effective_limit);
 
-  for (const auto &entry : entries) {
-    if (skip_by_cursor && entry.id <= cursor) {
-      continue;
-    }
-    batch.entries.push_back(entry);
-    if (batch.entries.size() >= effective_limit) {
-      break;
-    }
+  batch.entries.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const LogView entry_view = view(first_id + i);
+    LogEntry entry;
+    entry.id = entry_view.id;
+    entry.timestamp_ms = entry_view.timestamp_ms;
+    entry.level = entry_view.level;
+    entry.tag = std::string(entry_view.tag);
+    entry.message = std::string(entry_view.message);
+    batch.entries.push_back(std::move(entry));
   }
 
-  const uint64_t cursor_reference =
-      batch.entries.empty() ? cursor : batch.entries.back().id;
-  batch.next_cursor = cursor_reference;
-  batch.has_more = entries.back().id > cursor_reference;
-
+  batch.next_cursor = count > 0 ? first_id + count - 1 : cursor;
+  batch.has_more = next_id - 1 > batch.next_cursor;
   return batch;
 }
 
-void LogStore::clear() {
-  std::lock_guard<std::mutex> lock(mutex);
-  entries.clear();
+LogVisitResult LogStore::visit(uint64_t cursor, std::size_t limit, VisitFn fn,
+                               void *context) const {
+  LogVisitResult result;
+  result.next_cursor = cursor;
+
+  uint64_t resume = 0;
+  while (true) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stored() == 0) {
+      return result;
+    }
+
+    // Later chunks resume after the last visited id, or at the oldest entry if
+    // producers evicted it while the lock was released.
+    const uint64_t first_id = result.visited == 0
+                                  ? first_after(cursor)
+                                  : std::max(resume, next_id - stored());
+    std::size_t chunk = 0;
+    bool stopped = false;
+    for (uint64_t id = first_id;
+         id < next_id && result.visited < limit && chunk < visit_chunk;
+         ++id, ++chunk) {
+      if (!fn(context, view(id))) {
+        stopped = true;
+        break;
+      }
+      result.next_cursor = id;
+      ++result.visited;
+      resume = id + 1;
+    }
+
+    if (stopped || result.visited >= limit || chunk < visit_chunk) {
+      result.has_more = next_id - 1 > result.next_cursor;
+      return result;
+    }
+  }
 }
 
 Logger &Logger::instance() {
@@ -105,102 +822,186 @@ Logger &Logger::instance() {
   return logger;
 }
 
-Logger::Logger() : store() {}
+Logger::Logger() : store() {
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  const esp_err_t err = tasks::run_detached(
+      [this]() { drain(); }, "log_drain",
+      CONFIG_EARBRAIN_LOG_ASYNC_TASK_STACK_SIZE,
+      CONFIG_EARBRAIN_LOG_ASYNC_TASK_PRIORITY);
+  async_state().available.store(err == ESP_OK);
+#endif
+}
 
 void Logger::info(std::string_view message, std::string_view tag) {
-  write(ESP_LOG_INFO, tag, message);
+  if (enabled(ESP_LOG_INFO, tag)) {
+    write(ESP_LOG_INFO, tag, message);
+  }
 }
 
 void Logger::warn(std::string_view message, std::string_view tag) {
-  write(ESP_LOG_WARN, tag, message);
+  if (enabled(ESP_LOG_WARN, tag)) {
+    write(ESP_LOG_WARN, tag, message);
+  }
 }
 
 void Logger::error(std::string_view message, std::string_view tag) {
-  write(ESP_LOG_ERROR, tag, message);
+  if (enabled(ESP_LOG_ERROR, tag)) {
+    write(ESP_LOG_ERROR, tag, message);
+  }
 }
 
 void Logger::debug(std::string_view message, std::string_view tag) {
-  write(ESP_LOG_DEBUG, tag, message);
+  if (enabled(ESP_LOG_DEBUG, tag)) {
+    write(ESP_LOG_DEBUG, tag, message);
+  }
 }
 
 void Logger::infof(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_INFO, default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    info(message);
-  }
 }
 
 void Logger::infof(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_INFO, tag_or_default(tag), format, args);
   va_end(args);
-  if (!message.empty()) {
-    info(message, tag ? std::string_view{tag} : default_tag());
-  }
 }
 
 void Logger::warnf(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_WARN, default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    warn(message);
-  }
 }
 
 void Logger::warnf(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_WARN, tag_or_default(tag), format, args);
   va_end(args);
-  if (!message.empty()) {
-    warn(message, tag ? std::string_view{tag} : default_tag());
-  }
 }
 
 void Logger::errorf(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_ERROR, default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    error(message);
-  }
 }
 
 void Logger::errorf(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_ERROR, tag_or_default(tag), format, args);
   va_end(args);
-  if (!message.empty()) {
-    error(message, tag ? std::string_view{tag} : default_tag());
-  }
 }
 
 void Logger::debugf(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_DEBUG, default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    debug(message);
-  }
 }
 
 void Logger::debugf(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  vlogf(ESP_LOG_DEBUG, tag_or_default(tag), format, args);
+  va_end(args);
+}
+
+void Logger::logf(esp_log_level_t level, std::string_view tag,
+                  const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vlogf(level, tag, format, args);
   va_end(args);
-  if (!message.empty()) {
-    debug(message, tag ? std::string_view{tag} : default_tag());
+}
+
+void Logger::vlogf(esp_log_level_t level, std::string_view tag,
+                   const char *format, va_list args) {
+  if (!format || !enabled(level, tag)) {
+    return;
+  }
+
+  char buffer[format_buffer_size];
+  va_list copy;
+  va_copy(copy, args);
+  const int required = vsnprintf(buffer, sizeof(buffer), format, copy);
+  va_end(copy);
+  if (required <= 0) {
+    return;
   }
+
+  const auto length = static_cast<std::size_t>(required);
+  if (length < sizeof(buffer)) {
+    write(level, tag, std::string_view(buffer, length));
+    return;
+  }
+
+  std::unique_ptr<char[]> oversized(new (std::nothrow) char[length + 1]);
+  if (!oversized) {
+    write(level, tag, std::string_view(buffer, sizeof(buffer) - 1));
+    return;
+  }
+  earbrain::detail::note_allocation(MemoryTag::Logging, length + 1);
+  vsnprintf(oversized.get(), length + 1, format, args);
+  write(level, tag, std::string_view(oversized.get(), length));
+  earbrain::detail::note_deallocation(MemoryTag::Logging, length + 1);
+}
+
+bool Logger::runtime_enabled(esp_log_level_t level, std::string_view tag) const {
+  LevelTable &table = level_table();
+  if (table.count.load(std::memory_order_relaxed) > 0) {
+    if (const TagLevel *entry = find_tag_level(table, normalise_tag(tag))) {
+      return level <= entry->level.load(std::memory_order_relaxed);
+    }
+  }
+  return level <= table.default_level.load(std::memory_order_relaxed);
+}
+
+void Logger::level(esp_log_level_t level) {
+  level_table().default_level.store(level, std::memory_order_relaxed);
+}
+
+esp_log_level_t Logger::level() const {
+  return level_table().default_level.load(std::memory_order_relaxed);
+}
+
+esp_err_t Logger::level(std::string_view tag, esp_log_level_t level) {
+  tag = normalise_tag(tag);
+  if (tag.size() >= tag_level_name_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  LevelTable &table = level_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  if (TagLevel *entry = find_tag_level(table, tag)) {
+    entry->level.store(level, std::memory_order_relaxed);
+    return ESP_OK;
+  }
+
+  const std::size_t count = table.count.load(std::memory_order_relaxed);
+  if (count >= tag_level_slots) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  TagLevel &entry = table.entries[count];
+  std::memcpy(entry.tag, tag.data(), tag.size());
+  entry.tag_len = static_cast<uint8_t>(tag.size());
+  entry.level.store(level, std::memory_order_relaxed);
+  table.count.store(count + 1, std::memory_order_release);
+  return ESP_OK;
+}
+
+esp_log_level_t Logger::level(std::string_view tag) const {
+  LevelTable &table = level_table();
+  if (const TagLevel *entry = find_tag_level(table, normalise_tag(tag))) {
+    return entry->level.load(std::memory_order_relaxed);
+  }
+  return table.default_level.load(std::memory_order_relaxed);
 }
 
 LogBatch Logger::collect(uint64_t cursor, std::size_t limit) const {
@@ -209,17 +1010,184 @@ LogBatch Logger::collect(uint64_t cursor, std::size_t limit) const {
 
 void Logger::clear() { store.clear(); }
 
+std::size_t Logger::recovered() const { return store.recovered(); }
+
 void Logger::write(esp_log_level_t level, std::string_view tag,
                    std::string_view message) {
-  const std::string tag_copy = normalise_tag(tag);
-  const std::string message_copy(message);
+  EARBRAIN_TRACE_SCOPE("log.write");
+  tag = normalise_tag(tag);
 
-  store.log(level, tag_copy, message_copy);
-  std::string line_for_stdout = message_copy;
-  if (line_for_stdout.empty() || line_for_stdout.back() != '\n') {
-    line_for_stdout.push_back('\n');
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  if (enqueue(level, tag, message, false)) {
+    return;
   }
-  esp_log_write(level, tag_copy.c_str(), "%s", line_for_stdout.c_str());
+#endif
+
+  store.log(level, tag, message);
+  write_console(level, tag, message);
+}
+
+void Logger::write(esp_log_level_t level, std::string_view tag,
+                   const DeferredRecord &record) {
+  EARBRAIN_TRACE_SCOPE("log.write");
+  tag = normalise_tag(tag);
+
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  if constexpr (sizeof(DeferredRecord) <= sizeof(QueuedRecord::message)) {
+    if (enqueue(level, tag,
+                std::string_view(reinterpret_cast<const char *>(&record), sizeof(record)),
+                true)) {
+      return;
+    }
+  }
+#endif
+
+  store.log(level, tag, record);
+
+  char buffer[format_buffer_size];
+  write_console(level, tag, render(record, buffer, sizeof(buffer)));
+}
+
+#if CONFIG_EARBRAIN_LOG_ASYNC
+
+bool Logger::enqueue(esp_log_level_t level, std::string_view tag,
+                     std::string_view payload, bool deferred) {
+  auto &state = async_state();
+  if (!state.available.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  const uint32_t timestamp_ms = esp_log_timestamp();
+  auto fill = [&](QueuedRecord &record) {
+    const std::size_t tag_len = std::min(tag.size(), async_tag_size - 1);
+    const std::size_t message_len = std::min(payload.size(), sizeof(record.message));
+    record.timestamp_ms = timestamp_ms;
+    record.level = level;
+    record.message_len = static_cast<uint16_t>(message_len);
+    record.deferred = deferred;
+    std::memcpy(record.tag, tag.data(), tag_len);
+    record.tag[tag_len] = '\0';
+    std::memcpy(record.message, payload.data(), message_len);
+  };
+
+  const TickType_t start = xTaskGetTickCount();
+  while (!state.queue.try_push(fill)) {
+    const OverflowPolicy policy = state.policy.load(std::memory_order_relaxed);
+    if (policy == OverflowPolicy::DropOldest) {
+      if (state.queue.try_pop([](QueuedRecord &) {})) {
+        state.dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      continue;
+    }
+
+    // The drain task must never wait on itself.
+    const bool can_block =
+        policy == OverflowPolicy::Block &&
+        xTaskGetCurrentTaskHandle() != state.drain_task.load() &&
+        xTaskGetTickCount() - start <
+            pdMS_TO_TICKS(state.block_timeout_ms.load(std::memory_order_relaxed));
+    if (!can_block) {
+      state.dropped.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    vTaskDelay(1);
+  }
+
+  if (state.drain_sleeping.exchange(false)) {
+    if (TaskHandle_t task = state.drain_task.load()) {
+      xTaskNotifyGive(task);
+    }
+  }
+  return true;
+}
+
+void Logger::drain() {
+  auto &state = async_state();
+  state.drain_task.store(xTaskGetCurrentTaskHandle());
+
+  auto consume = [this](QueuedRecord &record) {
+    EARBRAIN_TRACE_SCOPE("log.drain");
+    if (record.deferred) {
+      DeferredRecord deferred;
+      std::memcpy(&deferred, record.message, sizeof(deferred));
+      store.log(record.level, record.tag, deferred, record.timestamp_ms);
+      char buffer[format_buffer_size];
+      write_console(record.level, record.tag, render(deferred, buffer, sizeof(buffer)));
+      return;
+    }
+    const std::string_view message(record.message, record.message_len);
+    store.log(record.level, record.tag, message, record.timestamp_ms);
+    write_console(record.level, record.tag, message);
+  };
+
+  for (;;) {
+    state.drain_busy.store(true);
+    while (state.queue.try_pop(consume)) {
+    }
+
+    state.drain_sleeping.store(true);
+    if (!state.queue.empty()) {
+      state.drain_sleeping.store(false);
+      continue;
+    }
+    state.drain_busy.store(false);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+#endif
+
+void Logger::overflow_policy(OverflowPolicy policy, uint32_t block_timeout_ms) {
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  auto &state = async_state();
+  state.policy.store(policy);
+  if (block_timeout_ms > 0) {
+    state.block_timeout_ms.store(block_timeout_ms);
+  }
+#else
+  (void)policy;
+  (void)block_timeout_ms;
+#endif
+}
+
+OverflowPolicy Logger::overflow_policy() const {
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  return async_state().policy.load();
+#else
+  return OverflowPolicy::Block;
+#endif
+}
+
+uint32_t Logger::dropped() const {
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  return async_state().dropped.load(std::memory_order_relaxed);
+#else
+  return 0;
+#endif
+}
+
+bool Logger::flush(uint32_t timeout_ms) {
+#if CONFIG_EARBRAIN_LOG_ASYNC
+  auto &state = async_state();
+  if (!state.available.load() ||
+      xTaskGetCurrentTaskHandle() == state.drain_task.load()) {
+    return state.queue.empty();
+  }
+
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t ticks = (timeout_ms == portMAX_DELAY)
+                               ? portMAX_DELAY
+                               : pdMS_TO_TICKS(timeout_ms);
+  while (!state.queue.empty() || state.drain_busy.load()) {
+    if (ticks != portMAX_DELAY && xTaskGetTickCount() - start >= ticks) {
+      return false;
+    }
+    vTaskDelay(1);
+  }
+#else
+  (void)timeout_ms;
+#endif
+  return true;
 }
 
 Logger &get_logger() { return Logger::instance(); }
@@ -243,81 +1211,63 @@ void debug(std::string_view message, std::string_view tag) {
 void infof(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_INFO, Logger::default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    info(message);
-  }
 }
 
 void infof(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_INFO, tag_or_default(tag), format, args);
   va_end(args);
-  if (!message.empty()) {
-    info(message, tag ? std::string_view{tag} : Logger::default_tag());
-  }
 }
 
 void warnf(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_WARN, Logger::default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    warn(message);
-  }
 }
 
 void warnf(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_WARN, tag_or_default(tag), format, args);
   va_end(args);
-  if (!message.empty()) {
-    warn(message, tag ? std::string_view{tag} : Logger::default_tag());
-  }
 }
 
 void errorf(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_ERROR, Logger::default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    error(message);
-  }
 }
 
 void errorf(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_ERROR, tag_or_default(tag), format, args);
   va_end(args);
-  if (!message.empty()) {
-    error(message, tag ? std::string_view{tag} : Logger::default_tag());
-  }
 }
 
 void debugf(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_DEBUG, Logger::default_tag(), format, args);
   va_end(args);
-  if (!message.empty()) {
-    debug(message);
-  }
 }
 
 void debugf(const char *tag, const char *format, ...) {
   va_list args;
   va_start(args, format);
-  const std::string message = format_message(format, args);
+  get_logger().vlogf(ESP_LOG_DEBUG, tag_or_default(tag), format, args);
   va_end(args);
-  if (!message.empty()) {
-    debug(message, tag ? std::string_view{tag} : Logger::default_tag());
-  }
+}
+
+void level(esp_log_level_t level) { get_logger().level(level); }
+
+esp_err_t level(std::string_view tag, esp_log_level_t level) {
+  return get_logger().level(tag, level);
 }
 
 LogBatch collect(uint64_t cursor, std::size_t limit) {
@@ -326,4 +1276,10 @@ LogBatch collect(uint64_t cursor, std::size_t limit) {
 
 void clear() { get_logger().clear(); }
 
+std::size_t recovered() { return get_logger().recovered(); }
+
+uint32_t dropped() { return get_logger().dropped(); }
+
+bool flush(uint32_t timeout_ms) { return get_logger().flush(timeout_ms); }
+
 } // namespace earbrain::logging
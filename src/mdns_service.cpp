@@ -1,8 +1,15 @@
 #include "earbrain/mdns_service.hpp"
 #include "earbrain/logging.hpp"
+#include "earbrain/task_pool.hpp"
+#include "earbrain/trace.hpp"
+#include "earbrain/wifi_service.hpp"
+
+#include <algorithm>
+#include <utility>
 
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "esp_random.h"
 #include "mdns.h"
 
 namespace earbrain {
@@ -10,10 +17,77 @@ namespace earbrain {
 namespace {
 
 constexpr const char mdns_tag[] = "mdns";
+constexpr uint64_t timer_retry_us = 100 * 1000;
+
+bool same_service(const MdnsServiceInfo &service, std::string_view service_type,
+                  std::string_view protocol) {
+  return service.service_type == service_type && service.protocol == protocol;
+}
+
+template <typename Services>
+MdnsServiceInfo *find_service(Services &services, std::string_view service_type,
+                              std::string_view protocol) {
+  for (MdnsServiceInfo &service : services) {
+    if (same_service(service, service_type, protocol)) {
+      return &service;
+    }
+  }
+  return nullptr;
+}
+
+// The primary service from the flat MdnsConfig fields, then the others.
+std::vector<MdnsServiceInfo> services_of(const MdnsConfig &config) {
+  std::vector<MdnsServiceInfo> services;
+  services.reserve(config.services.size() + 1);
+  if (!config.service_type.empty()) {
+    services.push_back(
+        MdnsServiceInfo{config.service_type, config.protocol, config.port, {}, config.txt});
+  }
+  for (const MdnsServiceInfo &service : config.services) {
+    if (!same_service(service, config.service_type, config.protocol)) {
+      services.push_back(service);
+    }
+  }
+  return services;
+}
+
+void assign_services(MdnsConfig &config, std::vector<MdnsServiceInfo> services) {
+  config.services.clear();
+  bool primary_found = false;
+  for (MdnsServiceInfo &service : services) {
+    if (!primary_found && same_service(service, config.service_type, config.protocol)) {
+      config.port = service.port;
+      config.txt = std::move(service.txt);
+      primary_found = true;
+    } else {
+      config.services.push_back(std::move(service));
+    }
+  }
+  if (!primary_found) {
+    config.service_type.clear();
+    config.txt.clear();
+  }
+}
+
+using TxtItems = std::vector<mdns_txt_item_t, TrackedAllocator<mdns_txt_item_t, MemoryTag::Mdns>>;
+
+TxtItems txt_items(const MdnsTxt &txt) {
+  TxtItems items;
+  items.reserve(txt.size());
+  for (const auto &[key, value] : txt) {
+    items.push_back(mdns_txt_item_t{key.c_str(), value.c_str()});
+  }
+  return items;
+}
 
 } // namespace
 
 esp_err_t MdnsService::initialize() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return initialize_locked();
+}
+
+esp_err_t MdnsService::initialize_locked() {
   if (initialized) {
     return ESP_OK;
   }
@@ -42,42 +116,57 @@ esp_err_t MdnsService::initialize() {
 }
 
 esp_err_t MdnsService::start(const MdnsConfig &config) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return start_locked(config);
+}
+
+esp_err_t MdnsService::start_locked(const MdnsConfig &config) {
   if (!initialized) return ESP_ERR_INVALID_STATE;
+  EARBRAIN_TRACE_SCOPE("mdns.start");
 
   if (running) {
-    const esp_err_t stop_err = stop();
-    if (stop_err != ESP_OK) {
-      return stop_err;
+    // Only a new hostname has to be probed again; everything else is
+    // re-announced in place.
+    if (config.hostname != mdns_config.hostname) {
+      const esp_err_t err = mdns_hostname_set(config.hostname.c_str());
+      if (err != ESP_OK) {
+        return err;
+      }
+      mdns_config.hostname = config.hostname;
+    }
+    if (config.instance_name != mdns_config.instance_name) {
+      const esp_err_t err = mdns_instance_name_set(config.instance_name.c_str());
+      if (err != ESP_OK) {
+        return err;
+      }
+      mdns_config.instance_name = config.instance_name;
     }
+    mdns_config.service_type = config.service_type;
+    mdns_config.protocol = config.protocol;
+    return apply_services(services_of(config));
   }
 
-  MdnsConfig applied = config;
-
-  esp_err_t err = mdns_hostname_set(applied.hostname.c_str());
+  esp_err_t err = mdns_hostname_set(config.hostname.c_str());
   if (err != ESP_OK) {
-    stop();
+    stop_locked();
     return err;
   }
 
-  err = mdns_instance_name_set(applied.instance_name.c_str());
+  err = mdns_instance_name_set(config.instance_name.c_str());
   if (err != ESP_OK) {
-    stop();
+    stop_locked();
     return err;
   }
 
-  err = mdns_service_add(nullptr, applied.service_type.c_str(),
-                         applied.protocol.c_str(), applied.port, nullptr, 0);
+  mdns_config = config;
+  advertised.clear();
+  running = true;
+  err = apply_services(services_of(config));
   if (err != ESP_OK) {
-    stop();
+    stop_locked();
     return err;
   }
 
-  mdns_config = std::move(applied);
-  service_registered = true;
-  registered_service_type = mdns_config.service_type;
-  registered_protocol = mdns_config.protocol;
-  running = true;
-
   logging::infof(mdns_tag,
                  "mDNS started: host=%s instance=%s service=%s protocol=%s port=%u",
                  mdns_config.hostname.c_str(),
@@ -90,10 +179,15 @@ esp_err_t MdnsService::start(const MdnsConfig &config) {
 }
 
 esp_err_t MdnsService::start() {
-  return start(mdns_config);
+  return start(config());
 }
 
 esp_err_t MdnsService::stop() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stop_locked();
+}
+
+esp_err_t MdnsService::stop_locked() {
   if (!initialized) {
     running = false;
     return ESP_OK;
@@ -101,19 +195,14 @@ esp_err_t MdnsService::stop() {
 
   esp_err_t first_error = ESP_OK;
 
-  if (service_registered && !registered_service_type.empty() &&
-      !registered_protocol.empty()) {
-    const esp_err_t err = mdns_service_remove(
-        registered_service_type.c_str(),
-        registered_protocol.c_str());
+  for (const MdnsServiceInfo &service : advertised) {
+    const esp_err_t err =
+        mdns_service_remove(service.service_type.c_str(), service.protocol.c_str());
     if (err != ESP_OK && first_error == ESP_OK) {
       first_error = err;
     }
   }
-
-  service_registered = false;
-  registered_service_type.clear();
-  registered_protocol.clear();
+  advertised.clear();
 
   mdns_free();
   initialized = false;
@@ -122,6 +211,397 @@ esp_err_t MdnsService::stop() {
   return first_error;
 }
 
+MdnsConfig MdnsService::config() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return mdns_config;
+}
+
+esp_err_t MdnsService::add_service(const MdnsServiceInfo &service) {
+  if (service.service_type.empty() || service.protocol.empty()) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<MdnsServiceInfo> next = services_of(mdns_config);
+  if (MdnsServiceInfo *existing = find_service(next, service.service_type, service.protocol)) {
+    *existing = service;
+  } else {
+    next.push_back(service);
+  }
+  return apply_services(std::move(next));
+}
+
+esp_err_t MdnsService::remove_service(std::string_view service_type,
+                                      std::string_view protocol) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<MdnsServiceInfo> next = services_of(mdns_config);
+  const auto it = std::find_if(next.begin(), next.end(), [&](const MdnsServiceInfo &entry) {
+    return same_service(entry, service_type, protocol);
+  });
+  if (it == next.end()) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  next.erase(it);
+  return apply_services(std::move(next));
+}
+
+std::vector<MdnsServiceInfo> MdnsService::services() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return services_of(mdns_config);
+}
+
+std::vector<MdnsServiceInfo> MdnsService::advertised_services() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::vector<MdnsServiceInfo>(advertised.begin(), advertised.end());
+}
+
+esp_err_t MdnsService::update_txt(
+    std::string_view service_type, std::string_view protocol,
+    const std::map<std::string, std::optional<std::string>> &changes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<MdnsServiceInfo> next = services_of(mdns_config);
+  MdnsServiceInfo *service = find_service(next, service_type, protocol);
+  if (!service) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  for (const auto &[key, value] : changes) {
+    if (value) {
+      service->txt[key] = *value;
+    } else {
+      service->txt.erase(key);
+    }
+  }
+  return apply_services(std::move(next));
+}
+
+esp_err_t MdnsService::set_txt(std::string_view service_type, std::string_view protocol,
+                               std::string_view key, std::string_view value) {
+  return update_txt(service_type, protocol, {{std::string(key), std::string(value)}});
+}
+
+esp_err_t MdnsService::remove_txt(std::string_view service_type, std::string_view protocol,
+                                  std::string_view key) {
+  return update_txt(service_type, protocol, {{std::string(key), std::nullopt}});
+}
+
+esp_err_t MdnsService::hostname(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (name == mdns_config.hostname) {
+    return ESP_OK;
+  }
+  std::string next(name);
+  if (running) {
+    const esp_err_t err = mdns_hostname_set(next.c_str());
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+  mdns_config.hostname = std::move(next);
+  return ESP_OK;
+}
+
+esp_err_t MdnsService::instance_name(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (name == mdns_config.instance_name) {
+    return ESP_OK;
+  }
+  std::string next(name);
+  if (running) {
+    // Services without their own instance name follow the default.
+    const esp_err_t err = mdns_instance_name_set(next.c_str());
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+  mdns_config.instance_name = std::move(next);
+  return ESP_OK;
+}
+
+// Callers hold `mutex`. Withdraws services missing from `next`, adds new
+// ones and updates only the fields that differ on the rest. `next` becomes
+// the requested set either way; the advertised set afterwards is whatever
+// actually went through, so a failure does not lose the request.
+esp_err_t MdnsService::apply_services(std::vector<MdnsServiceInfo> next) {
+  EARBRAIN_TRACE_SCOPE("mdns.apply_services");
+  assign_services(mdns_config, next);
+  if (!running) {
+    return ESP_OK;
+  }
+
+  esp_err_t first_error = ESP_OK;
+  auto note = [&](esp_err_t err, const char *what, const MdnsServiceInfo &service) {
+    if (err != ESP_OK) {
+      logging::warnf(mdns_tag, "Failed to %s %s.%s: %s", what, service.service_type.c_str(),
+                     service.protocol.c_str(), esp_err_to_name(err));
+      if (first_error == ESP_OK) {
+        first_error = err;
+      }
+    }
+    return err == ESP_OK;
+  };
+
+  std::vector<MdnsServiceInfo> applied;
+  applied.reserve(next.size());
+  for (const MdnsServiceInfo &current : advertised) {
+    if (!find_service(next, current.service_type, current.protocol) &&
+        !note(mdns_service_remove(current.service_type.c_str(), current.protocol.c_str()),
+              "remove", current)) {
+      applied.push_back(current);
+    }
+  }
+
+  for (MdnsServiceInfo &service : next) {
+    const char *type = service.service_type.c_str();
+    const char *proto = service.protocol.c_str();
+    MdnsServiceInfo *current = find_service(advertised, service.service_type, service.protocol);
+    if (!current) {
+      TxtItems items = txt_items(service.txt);
+      if (note(mdns_service_add(service.instance_name.empty() ? nullptr
+                                                              : service.instance_name.c_str(),
+                                type, proto, service.port, items.data(), items.size()),
+               "add", service)) {
+        applied.push_back(std::move(service));
+      }
+      continue;
+    }
+
+    MdnsServiceInfo result = *current;
+    if (current->port != service.port &&
+        note(mdns_service_port_set(type, proto, service.port), "update port of", service)) {
+      result.port = service.port;
+    }
+    if (current->instance_name != service.instance_name) {
+      const std::string &name =
+          service.instance_name.empty() ? mdns_config.instance_name : service.instance_name;
+      if (note(mdns_service_instance_name_set(type, proto, name.c_str()),
+               "rename", service)) {
+        result.instance_name = service.instance_name;
+      }
+    }
+    // The whole TXT set goes out in one go, so a batch of key changes is a
+    // single announcement.
+    if (current->txt != service.txt) {
+      TxtItems items = txt_items(service.txt);
+      if (note(mdns_service_txt_set(type, proto, items.data(), static_cast<uint8_t>(items.size())),
+               "update TXT of", service)) {
+        result.txt = std::move(service.txt);
+      }
+    }
+    applied.push_back(std::move(result));
+  }
+
+  advertised.assign(applied.begin(), applied.end());
+  return first_error;
+}
+
+esp_err_t MdnsService::attach(WifiService &wifi, const MdnsConfig &config,
+                              const MdnsLinkPolicy &policy) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (attached_wifi) {
+    attached_wifi->unsubscribe(link_subscription);
+    attached_wifi = nullptr;
+  }
+
+  if (!announce_timer) {
+    esp_timer_create_args_t args{};
+    args.callback = &MdnsService::on_announce_timer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "mdns_announce";
+    const esp_err_t err = esp_timer_create(&args, &announce_timer);
+    if (err != ESP_OK) {
+      announce_timer = nullptr;
+      return err;
+    }
+  }
+  if (!hold_timer) {
+    esp_timer_create_args_t args{};
+    args.callback = &MdnsService::on_hold_timer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "mdns_hold";
+    const esp_err_t err = esp_timer_create(&args, &hold_timer);
+    if (err != ESP_OK) {
+      hold_timer = nullptr;
+      return err;
+    }
+  }
+
+  if (running) {
+    const esp_err_t err = start_locked(config);
+    if (err != ESP_OK) {
+      return err;
+    }
+  } else {
+    mdns_config = config;
+  }
+
+  const WifiEventMask events =
+      wifi_event_mask(WifiEvent::Connected) | wifi_event_mask(WifiEvent::Disconnected);
+  link_subscription =
+      wifi.subscribe([this](const WifiEventData &event) { on_link_event(event); }, events);
+  if (link_subscription == 0) {
+    return ESP_ERR_NO_MEM;
+  }
+  attached_wifi = &wifi;
+  link_policy = policy;
+
+  const WifiStatus status = wifi.status();
+  link_up = status.sta_connected && status.sta_ip.addr != 0;
+  link_ip = status.sta_ip.addr;
+  if (link_up && (!running || link_ip != announced_ip)) {
+    schedule_announce();
+  }
+  return ESP_OK;
+}
+
+void MdnsService::detach() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!attached_wifi) {
+    return;
+  }
+  attached_wifi->unsubscribe(link_subscription);
+  attached_wifi = nullptr;
+  link_subscription = 0;
+  esp_timer_stop(announce_timer);
+  esp_timer_stop(hold_timer);
+  announce_pending = false;
+}
+
+bool MdnsService::is_attached() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return attached_wifi != nullptr;
+}
+
+// Runs on the Wi-Fi listener task.
+void MdnsService::on_link_event(const WifiEventData &event) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!attached_wifi) {
+    return;
+  }
+
+  if (event.event == WifiEvent::Connected) {
+    link_up = true;
+    link_ip = event.ip_address ? event.ip_address->addr : 0;
+    esp_timer_stop(hold_timer);
+    // Back on the same address: peers' caches are still right.
+    if (!running || link_ip != announced_ip) {
+      schedule_announce();
+    }
+    return;
+  }
+
+  link_up = false;
+  if (!running) {
+    return;
+  }
+  if (link_policy.hold_ms == 0) {
+    // Stopping waits on the mDNS task, so it goes to the pool as from the
+    // hold timer, which also retries when the pool cannot take it.
+    if (tasks::pool().submit([this]() { hold_expired(); }) != ESP_OK) {
+      esp_timer_start_once(hold_timer, timer_retry_us);
+    }
+    return;
+  }
+  // Every failed reconnect reports another disconnect; the hold runs from
+  // the first one.
+  if (!esp_timer_is_active(hold_timer)) {
+    esp_timer_start_once(hold_timer, static_cast<uint64_t>(link_policy.hold_ms) * 1000);
+  }
+}
+
+// Callers hold `mutex`. A request while one is pending joins it.
+void MdnsService::schedule_announce() {
+  if (announce_pending) {
+    return;
+  }
+  const int64_t now = esp_timer_get_time();
+  int64_t delay_us = 0;
+  if (last_announce_us != 0) {
+    const int64_t allowed_at =
+        last_announce_us + static_cast<int64_t>(link_policy.min_announce_interval_ms) * 1000;
+    delay_us = std::max<int64_t>(allowed_at - now, 0);
+  }
+  if (link_policy.announce_jitter_ms != 0) {
+    delay_us += static_cast<int64_t>(esp_random() % (link_policy.announce_jitter_ms + 1)) * 1000;
+  }
+  if (esp_timer_start_once(announce_timer, static_cast<uint64_t>(delay_us)) == ESP_OK) {
+    announce_pending = true;
+  }
+}
+
+// The timers run on the shared esp_timer task, and starting, stopping or
+// announcing waits on the mDNS task, so they only hand the work to the pool.
+// When the pool cannot take it, the timer tries again shortly.
+void MdnsService::on_announce_timer(void *arg) {
+  auto *self = static_cast<MdnsService *>(arg);
+  if (tasks::pool().submit([self]() { self->announce(); }) != ESP_OK) {
+    esp_timer_start_once(self->announce_timer, timer_retry_us);
+  }
+}
+
+void MdnsService::on_hold_timer(void *arg) {
+  auto *self = static_cast<MdnsService *>(arg);
+  if (tasks::pool().submit([self]() { self->hold_expired(); }) != ESP_OK) {
+    esp_timer_start_once(self->hold_timer, timer_retry_us);
+  }
+}
+
+void MdnsService::announce() {
+  std::lock_guard<std::mutex> lock(mutex);
+  announce_pending = false;
+  if (!attached_wifi || !link_up) {
+    return;
+  }
+
+  const bool starting = !running;
+  esp_err_t err = ESP_OK;
+  if (starting) {
+    err = initialize_locked();
+    if (err == ESP_OK) {
+      err = start_locked(mdns_config);
+    }
+    if (err != ESP_OK) {
+      logging::warnf(mdns_tag, "Failed to start mDNS on link up: %s", esp_err_to_name(err));
+      return;
+    }
+  }
+
+  // Looked up each time: the Wi-Fi service recreates it on mode changes.
+  esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  if (netif) {
+#if CONFIG_MDNS_PREDEF_NETIF_STA
+    // The predefined interface is already enabled and a fresh responder
+    // announces by itself.
+    err = starting ? ESP_OK : mdns_netif_action(netif, MDNS_EVENT_ANNOUNCE_IP4);
+#else
+    // Otherwise the responder only uses the STA netif once it is
+    // registered and enabled here.
+    err = mdns_register_netif(netif);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+      err = mdns_netif_action(netif, static_cast<mdns_event_actions_t>(MDNS_EVENT_ENABLE_IP4 |
+                                                                      MDNS_EVENT_ANNOUNCE_IP4));
+    }
+#endif
+    if (err != ESP_OK) {
+      logging::warnf(mdns_tag, "Failed to announce: %s", esp_err_to_name(err));
+    }
+  }
+
+  announced_ip = link_ip;
+  last_announce_us = esp_timer_get_time();
+}
+
+void MdnsService::hold_expired() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!attached_wifi || link_up || !running) {
+    return;
+  }
+  logging::infof(mdns_tag, "Link down for %u ms, stopping mDNS",
+                 static_cast<unsigned>(link_policy.hold_ms));
+  stop_locked();
+  announced_ip = 0;
+}
+
 MdnsService& mdns() {
   static MdnsService instance;
   return instance;
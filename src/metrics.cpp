@@ -1,12 +1,100 @@
 #include "earbrain/metrics.hpp"
+#include "freertos/task.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+// The linux target (host benchmarks) has neither esp_timer nor the heap
+// capabilities allocator: heap figures read as zero there and the sampler
+// does not start.
+#if CONFIG_IDF_TARGET_LINUX
+#include <chrono>
+#else
 #include "esp_heap_caps.h"
 #include "esp_timer.h"
+#endif
 
 namespace earbrain {
 
+namespace detail {
+
+MemoryCounters memory_counters[memory_tag_count];
+
+} // namespace detail
+
+namespace {
+
+#if CONFIG_IDF_TARGET_LINUX
+std::uint64_t now_ms() {
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        std::chrono::steady_clock::now().time_since_epoch())
+                                        .count());
+}
+#else
+std::uint64_t now_ms() { return static_cast<std::uint64_t>(esp_timer_get_time() / 1000); }
+#endif
+
+constexpr std::uint32_t seconds_per_minute = 60;
+constexpr std::uint32_t seconds_per_hour = 3600;
+
+void fold(MetricsStat &stat, std::uint32_t min, std::uint32_t max, bool first) {
+  stat.min = first ? min : std::min(stat.min, min);
+  stat.max = first ? max : std::max(stat.max, max);
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && \
+    !CONFIG_IDF_TARGET_LINUX
+
+constexpr std::size_t max_tasks = CONFIG_EARBRAIN_METRICS_MAX_TASKS;
+
+struct TaskHistory {
+  UBaseType_t task_number;
+  configRUN_TIME_COUNTER_TYPE runtime;
+};
+
+// Scratch space for uxTaskGetSystemState and the counters of the previous
+// snapshot, shared by every caller.
+struct TaskSampling {
+  std::mutex mutex;
+  TaskStatus_t status[max_tasks];
+  TaskHistory previous[max_tasks];
+  std::size_t previous_count = 0;
+  configRUN_TIME_COUNTER_TYPE previous_total = 0;
+};
+
+TaskSampling &task_sampling() {
+  static TaskSampling sampling;
+  return sampling;
+}
+
+configRUN_TIME_COUNTER_TYPE previous_runtime(const TaskSampling &sampling,
+                                             UBaseType_t task_number) {
+  for (std::size_t i = 0; i < sampling.previous_count; ++i) {
+    if (sampling.previous[i].task_number == task_number) {
+      return sampling.previous[i].runtime;
+    }
+  }
+  return 0;
+}
+
+#endif
+
+#if !CONFIG_IDF_TARGET_LINUX
+constexpr std::uint32_t heap_caps[heap_kind_count] = {
+    MALLOC_CAP_INTERNAL,
+    MALLOC_CAP_SPIRAM,
+    MALLOC_CAP_DMA,
+    MALLOC_CAP_EXEC,
+};
+#endif
+
+} // namespace
+
 Metrics collect_metrics() {
   Metrics metrics{};
 
+#if !CONFIG_IDF_TARGET_LINUX
   metrics.heap_total =
       static_cast<std::uint32_t>(heap_caps_get_total_size(MALLOC_CAP_8BIT));
   metrics.heap_free =
@@ -18,10 +106,309 @@ Metrics collect_metrics() {
       heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
   metrics.heap_largest_free_block = static_cast<std::uint32_t>(
       heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
-  metrics.timestamp_ms =
-      static_cast<std::uint64_t>(esp_timer_get_time() / 1000);
+#endif
+  metrics.timestamp_ms = now_ms();
 
   return metrics;
 }
 
+HeapSnapshot collect_heap_metrics(std::uint32_t mask) {
+  HeapSnapshot snapshot;
+  snapshot.timestamp_ms = now_ms();
+
+#if CONFIG_IDF_TARGET_LINUX
+  (void)mask;
+#else
+  for (std::size_t i = 0; i < heap_kind_count; ++i) {
+    if ((mask & heap_mask(static_cast<HeapKind>(i))) == 0) {
+      continue;
+    }
+
+    multi_heap_info_t info{};
+    heap_caps_get_info(&info, heap_caps[i]);
+
+    HeapMetrics &heap = snapshot.heaps[i];
+    heap.sampled = true;
+    heap.free = static_cast<std::uint32_t>(info.total_free_bytes);
+    heap.total = static_cast<std::uint32_t>(info.total_free_bytes +
+                                            info.total_allocated_bytes);
+    heap.min_free = static_cast<std::uint32_t>(info.minimum_free_bytes);
+    heap.largest_free_block = static_cast<std::uint32_t>(info.largest_free_block);
+    heap.allocated_blocks = static_cast<std::uint32_t>(info.allocated_blocks);
+    heap.free_blocks = static_cast<std::uint32_t>(info.free_blocks);
+    heap.fragmentation_ratio =
+        heap.free > 0 ? static_cast<float>(heap.largest_free_block) / heap.free
+                      : 0.0f;
+  }
+#endif
+
+  return snapshot;
+}
+
+MemorySnapshot collect_memory_usage() {
+  MemorySnapshot snapshot;
+  snapshot.timestamp_ms = now_ms();
+
+  for (std::size_t i = 0; i < memory_tag_count; ++i) {
+    const detail::MemoryCounters &counters = detail::memory_counters[i];
+    MemoryUsage &usage = snapshot.tags[i];
+    usage.live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+    usage.peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed);
+    usage.allocations = counters.allocations.load(std::memory_order_relaxed);
+    usage.live_allocations = counters.live_allocations.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+void reset_memory_peaks() {
+  for (detail::MemoryCounters &counters : detail::memory_counters) {
+    counters.peak_bytes.store(counters.live_bytes.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+  }
+}
+
+esp_err_t collect_task_metrics(TaskSnapshot &snapshot) {
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && \
+    !CONFIG_IDF_TARGET_LINUX
+  TaskSampling &sampling = task_sampling();
+  std::lock_guard<std::mutex> lock(sampling.mutex);
+
+  configRUN_TIME_COUNTER_TYPE total = 0;
+  const UBaseType_t count = uxTaskGetSystemState(sampling.status, max_tasks, &total);
+  if (count == 0) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  const auto interval = static_cast<std::uint32_t>(total - sampling.previous_total);
+  snapshot.count = count;
+  snapshot.interval = interval;
+  snapshot.core_load.fill(0.0f);
+
+  for (UBaseType_t i = 0; i < count; ++i) {
+    const TaskStatus_t &status = sampling.status[i];
+    TaskMetrics &task = snapshot.tasks[i];
+
+    std::strncpy(task.name, status.pcTaskName, sizeof(task.name) - 1);
+    task.name[sizeof(task.name) - 1] = '\0';
+    task.priority = status.uxCurrentPriority;
+    task.stack_high_water = status.usStackHighWaterMark;
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+    task.core = status.xCoreID == tskNO_AFFINITY ? -1 : static_cast<std::int32_t>(status.xCoreID);
+#else
+    task.core = -1;
+#endif
+    task.runtime = static_cast<std::uint32_t>(
+        status.ulRunTimeCounter - previous_runtime(sampling, status.xTaskNumber));
+    task.cpu_percent =
+        interval > 0 ? 100.0f * static_cast<float>(task.runtime) / interval : 0.0f;
+
+    // Whatever the idle task did not use on its core, the other tasks did.
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; ++core) {
+      if (status.xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+        snapshot.core_load[core] = std::max(0.0f, 100.0f - task.cpu_percent);
+      }
+    }
+  }
+
+  for (UBaseType_t i = 0; i < count; ++i) {
+    sampling.previous[i].task_number = sampling.status[i].xTaskNumber;
+    sampling.previous[i].runtime = sampling.status[i].ulRunTimeCounter;
+  }
+  sampling.previous_count = count;
+  sampling.previous_total = total;
+  return ESP_OK;
+#else
+  snapshot.count = 0;
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+MetricsSampler::~MetricsSampler() { stop(); }
+
+esp_err_t MetricsSampler::start(uint32_t period_ms) {
+  if (period_ms == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+#if CONFIG_IDF_TARGET_LINUX
+  return ESP_ERR_NOT_SUPPORTED;
+#else
+  if (running) {
+    const esp_err_t stop_err = stop();
+    if (stop_err != ESP_OK) {
+      return stop_err;
+    }
+  }
+
+  if (!timer) {
+    esp_timer_create_args_t args{};
+    args.callback = &MetricsSampler::on_timer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "metrics";
+    args.skip_unhandled_events = true;
+
+    const esp_err_t err = esp_timer_create(&args, &timer);
+    if (err != ESP_OK) {
+      timer = nullptr;
+      return err;
+    }
+  }
+
+  const esp_err_t err =
+      esp_timer_start_periodic(timer, static_cast<uint64_t>(period_ms) * 1000);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  period = period_ms;
+  running = true;
+  sample();
+  return ESP_OK;
+#endif
+}
+
+esp_err_t MetricsSampler::stop() {
+#if !CONFIG_IDF_TARGET_LINUX
+  if (!timer) {
+    return ESP_OK;
+  }
+
+  esp_err_t err = esp_timer_stop(timer);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    return err;
+  }
+  err = esp_timer_delete(timer);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  timer = nullptr;
+  running = false;
+#endif
+  return ESP_OK;
+}
+
+void MetricsSampler::on_timer(void *arg) {
+  static_cast<MetricsSampler *>(arg)->sample();
+}
+
+void MetricsSampler::sample() {
+  const Metrics metrics = collect_metrics();
+
+  MetricsSample sample{};
+  sample.timestamp_ms = static_cast<std::uint32_t>(metrics.timestamp_ms);
+  sample.heap_free = metrics.heap_free;
+  sample.heap_min_free = metrics.heap_min_free;
+  sample.heap_largest_free_block = metrics.heap_largest_free_block;
+
+  const auto now_s = static_cast<std::uint32_t>(metrics.timestamp_ms / 1000);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  raw.push(sample);
+  roll(now_s);
+
+  Accumulator &window = second_window;
+  const bool first = !window.active;
+  if (first) {
+    window.active = true;
+    window.window = now_s;
+  }
+  fold(window.heap_free, sample.heap_free, sample.heap_free, first);
+  fold(window.heap_largest_free_block, sample.heap_largest_free_block,
+       sample.heap_largest_free_block, first);
+  window.heap_min_free = sample.heap_min_free;
+  window.heap_free_sum += sample.heap_free;
+  window.heap_largest_free_block_sum += sample.heap_largest_free_block;
+  ++window.samples;
+}
+
+// Closes every window that `now_s` has left, finest first, so each closed
+// window is folded into the coarser window it belongs to before that one is
+// checked in turn.
+void MetricsSampler::roll(std::uint32_t now_s) {
+  auto close = [](Accumulator &window, std::uint32_t window_s) {
+    MetricsRollup rollup{};
+    rollup.start_s = window.window * window_s;
+    rollup.samples = window.samples;
+    rollup.heap_min_free = window.heap_min_free;
+    rollup.heap_free = window.heap_free;
+    rollup.heap_free.avg =
+        static_cast<std::uint32_t>(window.heap_free_sum / window.samples);
+    rollup.heap_largest_free_block = window.heap_largest_free_block;
+    rollup.heap_largest_free_block.avg = static_cast<std::uint32_t>(
+        window.heap_largest_free_block_sum / window.samples);
+    window = Accumulator{};
+    return rollup;
+  };
+
+  auto merge = [](Accumulator &window, const MetricsRollup &rollup,
+                  std::uint32_t window_s) {
+    const bool first = !window.active;
+    if (first) {
+      window.active = true;
+      window.window = rollup.start_s / window_s;
+    }
+    fold(window.heap_free, rollup.heap_free.min, rollup.heap_free.max, first);
+    fold(window.heap_largest_free_block, rollup.heap_largest_free_block.min,
+         rollup.heap_largest_free_block.max, first);
+    window.heap_min_free = rollup.heap_min_free;
+    window.heap_free_sum +=
+        static_cast<std::uint64_t>(rollup.heap_free.avg) * rollup.samples;
+    window.heap_largest_free_block_sum +=
+        static_cast<std::uint64_t>(rollup.heap_largest_free_block.avg) * rollup.samples;
+    window.samples += rollup.samples;
+  };
+
+  if (second_window.active && second_window.window != now_s) {
+    const MetricsRollup rollup = close(second_window, 1);
+    seconds.push(rollup);
+    merge(minute_window, rollup, seconds_per_minute);
+  }
+  if (minute_window.active && minute_window.window != now_s / seconds_per_minute) {
+    const MetricsRollup rollup = close(minute_window, seconds_per_minute);
+    minutes.push(rollup);
+    merge(hour_window, rollup, seconds_per_hour);
+  }
+  if (hour_window.active && hour_window.window != now_s / seconds_per_hour) {
+    hours.push(close(hour_window, seconds_per_hour));
+  }
+}
+
+SeriesBatch<MetricsSample> MetricsSampler::collect(uint64_t cursor,
+                                                   std::size_t limit) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return raw.collect(cursor, limit);
+}
+
+SeriesBatch<MetricsRollup> MetricsSampler::collect(MetricsResolution resolution,
+                                                   uint64_t cursor,
+                                                   std::size_t limit) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  switch (resolution) {
+  case MetricsResolution::Second:
+    return seconds.collect(cursor, limit);
+  case MetricsResolution::Minute:
+    return minutes.collect(cursor, limit);
+  case MetricsResolution::Hour:
+    return hours.collect(cursor, limit);
+  }
+  return {};
+}
+
+void MetricsSampler::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  raw.clear();
+  seconds.clear();
+  minutes.clear();
+  hours.clear();
+  second_window = Accumulator{};
+  minute_window = Accumulator{};
+  hour_window = Accumulator{};
+}
+
+MetricsSampler &metrics_sampler() {
+  static MetricsSampler instance;
+  return instance;
+}
+
 } // namespace earbrain
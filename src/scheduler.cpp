@@ -0,0 +1,211 @@
+#include "earbrain/scheduler.hpp"
+
+#include "freertos/task.h"
+
+namespace earbrain::tasks {
+
+namespace {
+
+constexpr uint32_t help_poll_ms = 1;
+
+} // namespace
+
+JoinHandle::~JoinHandle() {
+  while (finishing.load(std::memory_order_acquire) != 0) {
+    vTaskDelay(1);
+  }
+}
+
+bool JoinHandle::wait(uint32_t timeout_ms) {
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t ticks = (timeout_ms == portMAX_DELAY)
+                               ? portMAX_DELAY
+                               : pdMS_TO_TICKS(timeout_ms);
+  // The completion may still hold a wake-up from an earlier round of jobs,
+  // so the counter is what decides.
+  while (!done()) {
+    uint32_t remaining = portMAX_DELAY;
+    if (ticks != portMAX_DELAY) {
+      const TickType_t elapsed = xTaskGetTickCount() - start;
+      if (elapsed >= ticks) {
+        return false;
+      }
+      remaining = pdTICKS_TO_MS(ticks - elapsed);
+    }
+    completion.wait(remaining);
+  }
+  return true;
+}
+
+Scheduler::~Scheduler() { stop(); }
+
+esp_err_t Scheduler::start() {
+  if (running.load()) {
+    return ESP_OK;
+  }
+
+  stopping.store(false);
+  exited.store(0);
+  for (std::size_t i = 0; i < worker_count; ++i) {
+    Worker &worker = workers[i];
+    if (xTaskCreatePinnedToCore(&Scheduler::worker_main, "sched",
+                                CONFIG_EARBRAIN_SCHEDULER_STACK_SIZE, this,
+                                CONFIG_EARBRAIN_SCHEDULER_PRIORITY, &worker.task,
+                                static_cast<BaseType_t>(i)) != pdPASS) {
+      worker.task = nullptr;
+      running.store(true);
+      stop();
+      return ESP_FAIL;
+    }
+  }
+  running.store(true);
+  return ESP_OK;
+}
+
+esp_err_t Scheduler::stop() {
+  if (!running.load()) {
+    return ESP_OK;
+  }
+  const std::size_t self = current_index();
+  if (self < worker_count && workers[self].task == xTaskGetCurrentTaskHandle()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  std::size_t started = 0;
+  stopping.store(true);
+  for (Worker &worker : workers) {
+    if (worker.task) {
+      ++started;
+      xTaskNotifyGive(worker.task);
+    }
+  }
+  while (exited.load() < started) {
+    vTaskDelay(1);
+  }
+  for (Worker &worker : workers) {
+    worker.task = nullptr;
+  }
+  running.store(false);
+
+  // Nobody may be left waiting on a job that will never run.
+  for (std::size_t i = 0; i < worker_count; ++i) {
+    while (run_one(i)) {
+    }
+  }
+  return ESP_OK;
+}
+
+void Scheduler::spawn(JoinHandle &join, Job job, int core) {
+  join.add();
+  Entry entry{std::move(job), &join};
+
+  const std::size_t index = core >= 0 ? static_cast<std::size_t>(core) % worker_count
+                                      : current_index();
+  if (!running.load() || stopping.load() || !push(index, entry)) {
+    run(entry);
+    return;
+  }
+
+  // Wake both workers: the idle one is the one that should steal.
+  for (Worker &worker : workers) {
+    if (TaskHandle_t task = worker.task) {
+      xTaskNotifyGive(task);
+    }
+  }
+}
+
+void Scheduler::join(JoinHandle &join) {
+  const std::size_t index = current_index();
+  while (!join.done()) {
+    if (!run_one(index)) {
+      join.wait(help_poll_ms);
+    }
+  }
+}
+
+// stop() raises `stopping` before it drains the deques under the same lock,
+// so an entry pushed here is either drained or refused and run by spawn().
+bool Scheduler::push(std::size_t index, Entry &entry) {
+  Worker &worker = workers[index];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (stopping.load() || worker.count >= deque_capacity) {
+    return false;
+  }
+  worker.entries[(worker.head + worker.count) % deque_capacity] = std::move(entry);
+  ++worker.count;
+  return true;
+}
+
+// The owner takes the newest entry, which keeps its working set warm.
+bool Scheduler::pop(std::size_t index, Entry &entry) {
+  Worker &worker = workers[index];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.count == 0) {
+    return false;
+  }
+  --worker.count;
+  entry = std::move(worker.entries[(worker.head + worker.count) % deque_capacity]);
+  return true;
+}
+
+// Thieves take the oldest entry, away from the end the owner is working on.
+bool Scheduler::steal(std::size_t index, Entry &entry) {
+  for (std::size_t offset = 1; offset < worker_count; ++offset) {
+    Worker &victim = workers[(index + offset) % worker_count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.count == 0) {
+      continue;
+    }
+    entry = std::move(victim.entries[victim.head]);
+    victim.head = (victim.head + 1) % deque_capacity;
+    --victim.count;
+    return true;
+  }
+  return false;
+}
+
+bool Scheduler::run_one(std::size_t index) {
+  Entry entry;
+  if (!pop(index, entry) && !steal(index, entry)) {
+    return false;
+  }
+  run(entry);
+  return true;
+}
+
+void Scheduler::run(Entry &entry) {
+  if (entry.job) {
+    entry.job();
+  }
+  entry.job = nullptr;
+  if (JoinHandle *join = entry.join) {
+    entry.join = nullptr;
+    join->finish();
+  }
+}
+
+std::size_t Scheduler::current_index() const {
+  return static_cast<std::size_t>(xPortGetCoreID()) % worker_count;
+}
+
+void Scheduler::worker_main(void *param) {
+  auto *self = static_cast<Scheduler *>(param);
+  const std::size_t index = self->current_index();
+
+  while (!self->stopping.load()) {
+    if (!self->run_one(index)) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+  }
+
+  self->exited.fetch_add(1);
+  vTaskDelete(nullptr);
+}
+
+Scheduler &scheduler() {
+  static Scheduler instance;
+  [[maybe_unused]] static const esp_err_t started = instance.start();
+  return instance;
+}
+
+} // namespace earbrain::tasks
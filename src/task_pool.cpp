@@ -0,0 +1,213 @@
+#include "earbrain/task_pool.hpp"
+
+#include "bounded_queue.hpp"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <new>
+
+namespace earbrain::tasks {
+
+namespace {
+
+constexpr std::size_t queue_length =
+    std::bit_floor<std::size_t>(CONFIG_EARBRAIN_TASK_POOL_QUEUE_LENGTH);
+
+} // namespace
+
+// `items` counts queued jobs and `spaces` free slots, so workers and blocked
+// submitters sleep on a semaphore instead of polling the queue.
+struct TaskPool::State {
+  detail::BoundedQueue<Job, queue_length> queue;
+  SemaphoreHandle_t items = nullptr;
+  SemaphoreHandle_t spaces = nullptr;
+  SemaphoreHandle_t exited = nullptr;
+  TaskHandle_t workers[max_workers] = {};
+  std::size_t worker_count = 0;
+  std::atomic<bool> stopping{false};
+};
+
+// Pins the current State for the lifetime of the object. Registering before
+// loading the pointer means stop() either sees the user or the user sees
+// the null pointer.
+class TaskPool::Use {
+public:
+  explicit Use(const TaskPool &pool) : pool(pool) {
+    pool.users.fetch_add(1);
+    current = pool.state.load();
+  }
+  ~Use() { pool.users.fetch_sub(1); }
+
+  Use(const Use &) = delete;
+  Use &operator=(const Use &) = delete;
+
+  State *get() const { return current; }
+
+private:
+  const TaskPool &pool;
+  State *current = nullptr;
+};
+
+TaskPool::~TaskPool() { stop(); }
+
+esp_err_t TaskPool::start() { return start(TaskPoolConfig{}); }
+
+esp_err_t TaskPool::start(const TaskPoolConfig &config) {
+  if (state.load()) {
+    return ESP_OK;
+  }
+  if (config.workers == 0 || config.workers > max_workers) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  auto *created = new (std::nothrow) State();
+  if (!created) {
+    return ESP_ERR_NO_MEM;
+  }
+  created->items = xSemaphoreCreateCounting(queue_length, 0);
+  created->spaces = xSemaphoreCreateCounting(queue_length, queue_length);
+  created->exited = xSemaphoreCreateCounting(max_workers, 0);
+  if (!created->items || !created->spaces || !created->exited) {
+    state = created;
+    stop();
+    return ESP_ERR_NO_MEM;
+  }
+  state = created;
+
+  for (std::size_t i = 0; i < config.workers; ++i) {
+    const BaseType_t core =
+        config.pin_to_cores ? static_cast<BaseType_t>(i % portNUM_PROCESSORS)
+                            : tskNO_AFFINITY;
+    TaskHandle_t handle = nullptr;
+    if (xTaskCreatePinnedToCore(&TaskPool::worker, config.name, config.stack_size,
+                                created, config.priority, &handle, core) != pdPASS) {
+      stop();
+      return ESP_FAIL;
+    }
+    created->workers[created->worker_count++] = handle;
+  }
+  return ESP_OK;
+}
+
+esp_err_t TaskPool::stop() {
+  if (!state.load()) {
+    return ESP_OK;
+  }
+  if (in_worker()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  State *current = state.exchange(nullptr);
+  if (!current) {
+    return ESP_OK;
+  }
+  current->stopping.store(true);
+  // Wake submitters blocked on a full queue; each one passes the wake-up on.
+  if (current->spaces) {
+    xSemaphoreGive(current->spaces);
+  }
+  for (std::size_t i = 0; i < current->worker_count; ++i) {
+    xSemaphoreGive(current->items);
+  }
+  for (std::size_t i = 0; i < current->worker_count; ++i) {
+    xSemaphoreTake(current->exited, portMAX_DELAY);
+  }
+  while (users.load() != 0) {
+    vTaskDelay(1);
+  }
+
+  while (current->queue.try_pop([](Job &job) { job = nullptr; })) {
+  }
+  if (current->items) {
+    vSemaphoreDelete(current->items);
+  }
+  if (current->spaces) {
+    vSemaphoreDelete(current->spaces);
+  }
+  if (current->exited) {
+    vSemaphoreDelete(current->exited);
+  }
+  delete current;
+  return ESP_OK;
+}
+
+esp_err_t TaskPool::submit(Job job, uint32_t timeout_ms) {
+  const Use use(*this);
+  State *current = use.get();
+  if (!current || current->stopping.load()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!job) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  const TickType_t ticks = (timeout_ms == portMAX_DELAY)
+                               ? portMAX_DELAY
+                               : pdMS_TO_TICKS(timeout_ms);
+  if (xSemaphoreTake(current->spaces, ticks) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  if (current->stopping.load()) {
+    xSemaphoreGive(current->spaces);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // A free slot is guaranteed, but the consumer that freed it may not have
+  // released the cell in queue order yet.
+  while (!current->queue.try_push([&](Job &slot) { slot = std::move(job); })) {
+    vTaskDelay(1);
+  }
+  xSemaphoreGive(current->items);
+  return ESP_OK;
+}
+
+bool TaskPool::in_worker() const {
+  const Use use(*this);
+  const State *current = use.get();
+  if (!current) {
+    return false;
+  }
+  const TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for (std::size_t i = 0; i < current->worker_count; ++i) {
+    if (current->workers[i] == self) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskPool::worker(void *param) {
+  auto *current = static_cast<State *>(param);
+
+  for (;;) {
+    xSemaphoreTake(current->items, portMAX_DELAY);
+    if (current->stopping.load()) {
+      break;
+    }
+
+    Job job;
+    while (!current->queue.try_pop([&](Job &slot) { job = std::move(slot); })) {
+      vTaskDelay(1);
+    }
+    xSemaphoreGive(current->spaces);
+    job();
+  }
+
+  xSemaphoreGive(current->exited);
+  vTaskDelete(nullptr);
+}
+
+TaskPool &pool() {
+  static TaskPool instance;
+  static std::mutex start_mutex;
+  if (!instance.is_running()) {
+    std::lock_guard<std::mutex> lock(start_mutex);
+    instance.start();
+  }
+  return instance;
+}
+
+} // namespace earbrain::tasks
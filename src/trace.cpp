@@ -0,0 +1,274 @@
+#include "earbrain/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_rom_sys.h"
+#endif
+
+namespace earbrain::trace {
+
+namespace {
+
+#if CONFIG_EARBRAIN_TRACE
+
+constexpr std::size_t ring_capacity = std::bit_floor<std::size_t>(CONFIG_EARBRAIN_TRACE_EVENTS);
+constexpr std::size_t ring_count = portNUM_PROCESSORS;
+
+// The cursor keeps one 32-bit ring position per core.
+static_assert(ring_count <= 2, "trace cursors hold positions for two cores");
+
+// Every field is a word-sized atomic so that a reader racing a writer sees
+// a torn slot through its sequence, never undefined behaviour. 64-bit
+// atomics are not lock-free on the ESP32, hence the split start time.
+struct Slot {
+  std::atomic<uint32_t> sequence{0};
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint32_t> start_low{0};
+  std::atomic<uint32_t> start_high{0};
+  std::atomic<uint32_t> duration_us{0};
+  std::atomic<uint32_t> duration_cycles{0};
+  std::atomic<uintptr_t> task{0};
+};
+
+// Written by whatever runs on one core: tasks that preempt each other and
+// ISRs. A writer claims a position with one fetch_add and publishes the slot
+// with a sequence of 2 * position + 2, odd while it is being written.
+// Nothing takes a lock, so a writer never waits for a reader or another
+// writer; a reader that loses a race to a wrapping writer drops the span.
+struct Ring {
+  std::atomic<uint32_t> head{0};
+  // Position of the oldest span after the last clear().
+  std::atomic<uint32_t> first{0};
+  Slot slots[ring_capacity];
+};
+
+Ring rings[ring_count];
+
+constexpr uint32_t published(uint32_t position) { return position * 2 + 2; }
+
+enum class ReadResult {
+  Ok,
+  Dropped,
+  Pending
+};
+
+ReadResult read_slot(const Ring &ring, uint32_t position, uint8_t core, TraceEvent &event) {
+  const Slot &slot = ring.slots[position % ring_capacity];
+  const uint32_t before = slot.sequence.load(std::memory_order_acquire);
+  if (before != published(position)) {
+    // Already reused for a later position, or not yet finished.
+    return static_cast<int32_t>(before - published(position)) > 0 ? ReadResult::Dropped
+                                                                   : ReadResult::Pending;
+  }
+
+  event.name = slot.name.load(std::memory_order_relaxed);
+  const uint64_t start = (static_cast<uint64_t>(slot.start_high.load(std::memory_order_relaxed))
+                          << 32) |
+                         slot.start_low.load(std::memory_order_relaxed);
+  event.start_us = static_cast<int64_t>(start);
+  event.duration_us = slot.duration_us.load(std::memory_order_relaxed);
+  event.duration_cycles = slot.duration_cycles.load(std::memory_order_relaxed);
+  event.task = slot.task.load(std::memory_order_relaxed);
+  event.core = core;
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.sequence.load(std::memory_order_relaxed) == before ? ReadResult::Ok
+                                                                 : ReadResult::Dropped;
+}
+
+#endif // CONFIG_EARBRAIN_TRACE
+
+// Microsecond values with three decimals, without going through double
+// formatting for the integer part.
+void append_micros(std::string &out, uint64_t nanos) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%" PRIu64 ".%03u", nanos / 1000,
+                static_cast<unsigned>(nanos % 1000));
+  out += buffer;
+}
+
+void append_escaped(std::string &out, const char *text) {
+  for (; *text; ++text) {
+    const char c = *text;
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      out += c;
+    }
+  }
+}
+
+uint32_t cycles_per_us() {
+#if CONFIG_IDF_TARGET_LINUX
+  return 1000;
+#elif CONFIG_PM_ENABLE
+  // The clock may have changed during the span; only esp_timer is reliable.
+  return 0;
+#else
+  return esp_rom_get_cpu_ticks_per_us();
+#endif
+}
+
+} // namespace
+
+namespace detail {
+
+void push(const TraceEvent &event) {
+#if CONFIG_EARBRAIN_TRACE
+  Ring &ring = rings[event.core < ring_count ? event.core : 0];
+  const uint32_t position = ring.head.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = ring.slots[position % ring_capacity];
+
+  slot.sequence.store(published(position) - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(event.name, std::memory_order_relaxed);
+  const auto start = static_cast<uint64_t>(event.start_us);
+  slot.start_low.store(static_cast<uint32_t>(start), std::memory_order_relaxed);
+  slot.start_high.store(static_cast<uint32_t>(start >> 32), std::memory_order_relaxed);
+  slot.duration_us.store(event.duration_us, std::memory_order_relaxed);
+  slot.duration_cycles.store(event.duration_cycles, std::memory_order_relaxed);
+  slot.task.store(event.task, std::memory_order_relaxed);
+  slot.sequence.store(published(position), std::memory_order_release);
+#else
+  (void)event;
+#endif
+}
+
+} // namespace detail
+
+TraceBatch collect(uint64_t cursor, std::size_t limit) {
+  TraceBatch batch;
+#if CONFIG_EARBRAIN_TRACE
+  uint32_t positions[ring_count];
+  uint32_t heads[ring_count];
+  bool stalled[ring_count] = {};
+  for (std::size_t core = 0; core < ring_count; ++core) {
+    const Ring &ring = rings[core];
+    uint32_t position = static_cast<uint32_t>(cursor >> (32 * core));
+    heads[core] = ring.head.load(std::memory_order_acquire);
+
+    const uint32_t first = ring.first.load(std::memory_order_relaxed);
+    if (static_cast<int32_t>(first - position) > 0) {
+      position = first;
+    }
+    if (heads[core] - position > ring_capacity) {
+      batch.dropped += heads[core] - position - static_cast<uint32_t>(ring_capacity);
+      position = heads[core] - static_cast<uint32_t>(ring_capacity);
+    }
+    positions[core] = position;
+  }
+
+  // Round robin over the cores, so that a busy core cannot use up the
+  // whole limit.
+  batch.events.reserve(std::min<std::size_t>(limit, ring_capacity * ring_count));
+  bool progressed = true;
+  while (batch.events.size() < limit && progressed) {
+    progressed = false;
+    for (std::size_t core = 0; core < ring_count && batch.events.size() < limit; ++core) {
+      if (stalled[core] || positions[core] == heads[core]) {
+        continue;
+      }
+      TraceEvent event{};
+      switch (read_slot(rings[core], positions[core], static_cast<uint8_t>(core), event)) {
+      case ReadResult::Ok:
+        batch.events.push_back(event);
+        ++positions[core];
+        break;
+      case ReadResult::Dropped:
+        ++batch.dropped;
+        ++positions[core];
+        break;
+      case ReadResult::Pending:
+        // A preempted writer still owns this slot; pick it up next time.
+        stalled[core] = true;
+        continue;
+      }
+      progressed = true;
+    }
+  }
+
+  for (std::size_t core = 0; core < ring_count; ++core) {
+    batch.has_more = batch.has_more || (!stalled[core] && positions[core] != heads[core]);
+    batch.next_cursor |= static_cast<uint64_t>(positions[core]) << (32 * core);
+  }
+#else
+  (void)cursor;
+  (void)limit;
+#endif
+  return batch;
+}
+
+void clear() {
+#if CONFIG_EARBRAIN_TRACE
+  for (Ring &ring : rings) {
+    ring.first.store(ring.head.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+#endif
+}
+
+std::string to_chrome_json(const TraceBatch &batch) {
+  const uint32_t ticks_per_us = cycles_per_us();
+  uint32_t cores_seen = 0;
+
+  std::string out;
+  out.reserve(64 + batch.events.size() * 112);
+  out += "{\"traceEvents\":[";
+  bool first = true;
+  char buffer[96];
+  for (const TraceEvent &event : batch.events) {
+    if (!event.name) {
+      continue;
+    }
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+
+    const char *dot = event.name;
+    while (*dot && *dot != '.') {
+      ++dot;
+    }
+    const uint64_t duration_ns =
+        event.duration_cycles != 0 && ticks_per_us != 0
+            ? static_cast<uint64_t>(event.duration_cycles) * 1000 / ticks_per_us
+            : static_cast<uint64_t>(event.duration_us) * 1000;
+
+    out += "{\"name\":\"";
+    append_escaped(out, event.name);
+    out += "\",\"cat\":\"";
+    out.append(event.name, static_cast<std::size_t>(dot - event.name));
+    std::snprintf(buffer, sizeof(buffer), "\",\"ph\":\"X\",\"ts\":%" PRId64 ",\"dur\":",
+                  event.start_us);
+    out += buffer;
+    append_micros(out, duration_ns);
+    std::snprintf(buffer, sizeof(buffer), ",\"pid\":%u,\"tid\":%" PRIuPTR "}",
+                  static_cast<unsigned>(event.core), event.task);
+    out += buffer;
+    cores_seen |= 1u << (event.core & 31);
+  }
+
+  for (unsigned core = 0; core < 32; ++core) {
+    if ((cores_seen & (1u << core)) == 0) {
+      continue;
+    }
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,"
+                  "\"args\":{\"name\":\"core %u\"}}",
+                  core, core);
+    out += buffer;
+  }
+  out += "],\"displayTimeUnit\":\"ms\"}";
+  return out;
+}
+
+} // namespace earbrain::trace
@@ -0,0 +1,242 @@
+#include "earbrain/logging.hpp"
+#include "earbrain/wifi_service.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+#include "nvs.h"
+
+namespace earbrain {
+
+namespace {
+
+constexpr const char *store_tag = "wifi_store";
+constexpr char store_namespace[] = "earbrain_nets";
+constexpr char store_key[] = "networks";
+constexpr uint8_t store_version = 1;
+
+struct StoredNetwork {
+  uint8_t priority;
+  char ssid[33];
+  char passphrase[65];
+};
+
+struct StoredNetworks {
+  uint8_t version;
+  uint8_t count;
+  StoredNetwork entries[WifiCredentialStore::max_networks];
+};
+
+constexpr std::size_t stored_size(std::size_t count) {
+  return offsetof(StoredNetworks, entries) + count * sizeof(StoredNetwork);
+}
+
+void copy_field(char *out, std::size_t size, const std::string &value) {
+  const std::size_t length = std::min(value.size(), size - 1);
+  std::memcpy(out, value.data(), length);
+  out[length] = '\0';
+}
+
+std::string read_field(const char *in, std::size_t size) {
+  return std::string(in, strnlen(in, size));
+}
+
+// Keeps `entries` ranked: stable, so among equal priorities the most
+// recently saved network stays in front.
+void rank(std::vector<KnownNetwork> &entries) {
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const KnownNetwork &a, const KnownNetwork &b) {
+                     return a.priority > b.priority;
+                   });
+}
+
+} // namespace
+
+std::vector<KnownNetwork> WifiCredentialStore::networks() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+  return entries;
+}
+
+std::optional<KnownNetwork> WifiCredentialStore::find(std::string_view ssid) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+  for (const KnownNetwork &network : entries) {
+    if (network.ssid == ssid) {
+      return network;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<KnownNetwork> WifiCredentialStore::top() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+  if (entries.empty()) {
+    return std::nullopt;
+  }
+  return entries.front();
+}
+
+std::size_t WifiCredentialStore::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+  return entries.size();
+}
+
+esp_err_t WifiCredentialStore::save(const KnownNetwork &network) {
+  if (network.ssid.empty() || network.ssid.size() > 32 || network.passphrase.size() > 64) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+
+  std::vector<KnownNetwork> next = entries;
+  auto existing = std::find_if(next.begin(), next.end(), [&](const KnownNetwork &entry) {
+    return entry.ssid == network.ssid;
+  });
+  if (existing != next.end()) {
+    if (existing->passphrase == network.passphrase &&
+        existing->priority == network.priority) {
+      return ESP_OK;
+    }
+    next.erase(existing);
+  }
+
+  // Ranked first, so a full store drops whatever ends up last, which may be
+  // the network being saved.
+  next.insert(next.begin(), network);
+  rank(next);
+  if (next.size() > max_networks) {
+    if (next.back().ssid == network.ssid) {
+      logging::warnf(store_tag, "Store full, '%s' ranks below every saved network",
+                     network.ssid.c_str());
+      return ESP_ERR_NO_MEM;
+    }
+    logging::infof(store_tag, "Store full, dropping '%s'", next.back().ssid.c_str());
+    next.pop_back();
+  }
+  return commit(std::move(next));
+}
+
+esp_err_t WifiCredentialStore::remove(std::string_view ssid) {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+  std::vector<KnownNetwork> next = entries;
+  auto existing = std::find_if(next.begin(), next.end(), [&](const KnownNetwork &entry) {
+    return entry.ssid == ssid;
+  });
+  if (existing == next.end()) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  next.erase(existing);
+  return commit(std::move(next));
+}
+
+esp_err_t WifiCredentialStore::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+  if (entries.empty()) {
+    return ESP_OK;
+  }
+  return commit({});
+}
+
+std::optional<KnownNetwork> WifiCredentialStore::best_match(const WifiScanResult &scan) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensure_loaded();
+
+  const KnownNetwork *best = nullptr;
+  int best_signal = -1;
+  for (const KnownNetwork &network : entries) {
+    for (const WifiNetworkSummary &seen : scan.networks) {
+      if (seen.ssid != network.ssid || seen.signal <= best_signal) {
+        continue;
+      }
+      // Entries are ranked, so a lower priority never beats one we have.
+      if (best && network.priority < best->priority) {
+        continue;
+      }
+      best = &network;
+      best_signal = seen.signal;
+    }
+  }
+  if (!best) {
+    return std::nullopt;
+  }
+  return *best;
+}
+
+// Callers hold `mutex`.
+void WifiCredentialStore::ensure_loaded() const {
+  if (loaded) {
+    return;
+  }
+  loaded = true;
+
+  nvs_handle_t handle;
+  if (nvs_open(store_namespace, NVS_READONLY, &handle) != ESP_OK) {
+    return;
+  }
+  // Off the stack: this runs on the event loop task too.
+  auto stored = std::make_unique<StoredNetworks>();
+  std::size_t size = sizeof(StoredNetworks);
+  const esp_err_t err = nvs_get_blob(handle, store_key, stored.get(), &size);
+  nvs_close(handle);
+  if (err != ESP_OK || size < stored_size(0) || stored->version != store_version ||
+      size != stored_size(std::min<std::size_t>(stored->count, max_networks))) {
+    return;
+  }
+
+  for (std::size_t i = 0; i < stored->count && i < max_networks; ++i) {
+    const StoredNetwork &record = stored->entries[i];
+    entries.push_back(KnownNetwork{read_field(record.ssid, sizeof(record.ssid)),
+                                   read_field(record.passphrase, sizeof(record.passphrase)),
+                                   record.priority});
+  }
+  rank(entries);
+}
+
+// Callers hold `mutex`. Changes are made on a copy that only replaces
+// `entries` once it is in flash, so a failed write leaves both unchanged.
+esp_err_t WifiCredentialStore::commit(std::vector<KnownNetwork> next) {
+  const esp_err_t err = persist(next);
+  if (err == ESP_OK) {
+    entries.swap(next);
+  }
+  return err;
+}
+
+// The whole list goes out as one blob and one commit.
+esp_err_t WifiCredentialStore::persist(const std::vector<KnownNetwork> &networks) {
+  auto stored = std::make_unique<StoredNetworks>();
+  stored->version = store_version;
+  stored->count = static_cast<uint8_t>(networks.size());
+  for (std::size_t i = 0; i < networks.size(); ++i) {
+    StoredNetwork &record = stored->entries[i];
+    record.priority = networks[i].priority;
+    copy_field(record.ssid, sizeof(record.ssid), networks[i].ssid);
+    copy_field(record.passphrase, sizeof(record.passphrase), networks[i].passphrase);
+  }
+
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(store_namespace, NVS_READWRITE, &handle);
+  if (err != ESP_OK) {
+    logging::errorf(store_tag, "Failed to open credential store: %s", esp_err_to_name(err));
+    return err;
+  }
+  err = nvs_set_blob(handle, store_key, stored.get(), stored_size(networks.size()));
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  if (err != ESP_OK) {
+    logging::errorf(store_tag, "Failed to write credential store: %s", esp_err_to_name(err));
+  }
+  return err;
+}
+
+} // namespace earbrain
@@ -1,10 +1,14 @@
 #include "earbrain/wifi_service.hpp"
+#include "bounded_queue.hpp"
 #include "earbrain/logging.hpp"
+#include "earbrain/trace.hpp"
 #include "earbrain/validation.hpp"
 
 #include <algorithm>
+#include <bit>
 #include <cstdio>
 #include <cstring>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -14,12 +18,16 @@
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "esp_netif_ip_addr.h"
+#include "esp_random.h"
 #include "esp_smartconfig.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_wifi_default.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "lwip/ip4_addr.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pkcs5.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 
@@ -29,7 +37,13 @@ namespace {
 
 constexpr char wifi_tag[] = "wifi";
 
-constexpr uint8_t sta_listen_interval = 1;
+// Control block and object in one allocation, charged to MemoryTag::Wifi.
+template <typename T, typename... Args>
+std::shared_ptr<T> make_tracked_shared(Args &&...args) {
+  return std::allocate_shared<T>(TrackedAllocator<T, MemoryTag::Wifi>{},
+                                 std::forward<Args>(args)...);
+}
+
 int signal_quality_from_rssi(int32_t rssi) {
   if (rssi <= -100) {
     return 0;
@@ -48,6 +62,47 @@ std::string format_bssid(const uint8_t (&bssid)[6]) {
   return std::string(buffer);
 }
 
+// Records kept by the roaming scan; more APs than this are not worth ranking.
+constexpr std::size_t roam_scan_capacity = 32;
+
+// Visible networks, strongest first. The connected flags are left to the caller.
+WifiScanResult summarize_scan(std::span<const wifi_ap_record_t> records) {
+  WifiScanResult result{};
+  result.networks.reserve(records.size());
+
+  for (const auto &record : records) {
+    WifiNetworkSummary summary{};
+
+    // Check for hidden network first
+    const char *ssid_raw = reinterpret_cast<const char *>(record.ssid);
+    size_t ssid_len = ssid_raw ? strnlen(ssid_raw, sizeof(record.ssid)) : 0;
+    summary.hidden = (ssid_len == 0);
+
+    // Skip hidden networks (no SSID to display)
+    if (summary.hidden) {
+      continue;
+    }
+
+    summary.ssid.assign(ssid_raw, ssid_len);
+    summary.bssid = format_bssid(record.bssid);
+    summary.rssi = record.rssi;
+    summary.signal = signal_quality_from_rssi(record.rssi);
+    summary.channel = record.primary;
+    summary.auth_mode = record.authmode;
+    summary.connected = false;
+
+    result.networks.push_back(std::move(summary));
+  }
+
+  // Sort by signal strength
+  std::sort(result.networks.begin(), result.networks.end(), [](const WifiNetworkSummary &a, const WifiNetworkSummary &b) {
+    return a.signal > b.signal;
+  });
+
+  result.error = ESP_OK;
+  return result;
+}
+
 // Safe copy helpers for SSID and password
 void copy_ssid_safe(uint8_t (&dst)[32], std::string_view src) {
   const size_t len = std::min(src.size(), size_t(32));
@@ -81,7 +136,7 @@ wifi_config_t make_ap_config(const AccessPointConfig &config) {
   return cfg;
 }
 
-wifi_config_t make_sta_config(const WifiCredentials &creds) {
+wifi_config_t make_sta_config(const WifiCredentials &creds, uint16_t listen_interval) {
   wifi_config_t cfg{};
   copy_ssid_safe(cfg.sta.ssid, creds.ssid);
   if (!creds.passphrase.empty()) {
@@ -90,7 +145,7 @@ wifi_config_t make_sta_config(const WifiCredentials &creds) {
 
   cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
   cfg.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
-  cfg.sta.listen_interval = sta_listen_interval;
+  cfg.sta.listen_interval = listen_interval;
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
   cfg.sta.pmf_cfg.capable = true;
   cfg.sta.pmf_cfg.required = false;
@@ -100,6 +155,82 @@ wifi_config_t make_sta_config(const WifiCredentials &creds) {
   return cfg;
 }
 
+constexpr char fast_connect_namespace[] = "earbrain_wifi";
+constexpr char fast_connect_key[] = "fast";
+
+// Detects a changed passphrase without keeping a second copy of it.
+uint32_t hash_passphrase(std::string_view passphrase) {
+  uint32_t hash = 2166136261u;
+  for (const char c : passphrase) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+// Modes where a raw PMK can stand in for the passphrase; SAE needs the
+// passphrase itself.
+bool pmk_usable(wifi_auth_mode_t mode) {
+  return mode == WIFI_AUTH_WPA_PSK || mode == WIFI_AUTH_WPA2_PSK ||
+         mode == WIFI_AUTH_WPA_WPA2_PSK;
+}
+
+// Backing storage for the pointers in a wifi_scan_config_t.
+struct ScanTarget {
+  uint8_t ssid[33];
+  uint8_t bssid[6];
+};
+
+wifi_scan_config_t make_scan_config(const WifiScanOptions &options, uint8_t channel,
+                                    ScanTarget &target) {
+  wifi_scan_config_t cfg{};
+  cfg.show_hidden = options.show_hidden;
+  cfg.channel = channel;
+  cfg.scan_type = options.scan_type;
+  if (!options.ssid.empty()) {
+    const size_t len = std::min(options.ssid.size(), sizeof(target.ssid) - 1);
+    std::memcpy(target.ssid, options.ssid.data(), len);
+    target.ssid[len] = '\0';
+    cfg.ssid = target.ssid;
+  }
+  if (options.bssid) {
+    std::memcpy(target.bssid, options.bssid->data(), sizeof(target.bssid));
+    cfg.bssid = target.bssid;
+  }
+  if (options.scan_type == WIFI_SCAN_TYPE_PASSIVE) {
+    cfg.scan_time.passive = options.max_dwell_ms;
+  } else {
+    cfg.scan_time.active.min = options.min_dwell_ms;
+    cfg.scan_time.active.max = options.max_dwell_ms;
+  }
+  return cfg;
+}
+
+// Bitmap of the channels allowed by the configured country.
+uint16_t country_channels() {
+  wifi_country_t country{};
+  uint8_t first = 1;
+  uint8_t count = 13;
+  if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0) {
+    first = country.schan;
+    count = country.nchan;
+  }
+  uint16_t mask = 0;
+  for (uint8_t channel = first; channel < first + count && channel <= 14; ++channel) {
+    mask |= WifiScanOptions::channel_bit(channel);
+  }
+  return mask;
+}
+
+// Whether a cached scan answers `wanted`; the age limit is checked apart.
+bool same_scan(const WifiScanOptions &cached, const WifiScanOptions &wanted) {
+  return cached.show_hidden == wanted.show_hidden &&
+         cached.per_channel == wanted.per_channel &&
+         cached.channels == wanted.channels && cached.ssid == wanted.ssid &&
+         cached.bssid == wanted.bssid && cached.scan_type == wanted.scan_type &&
+         cached.min_dwell_ms == wanted.min_dwell_ms &&
+         cached.max_dwell_ms == wanted.max_dwell_ms;
+}
+
 esp_err_t validate_station_config(const WifiCredentials &creds) {
   if (!validation::is_valid_ssid(creds.ssid)) {
     logging::error("Invalid STA SSID (length must be 1-32 bytes)", wifi_tag);
@@ -112,8 +243,30 @@ esp_err_t validate_station_config(const WifiCredentials &creds) {
   return ESP_OK;
 }
 
+constexpr std::size_t event_queue_length =
+    std::bit_floor<std::size_t>(CONFIG_EARBRAIN_WIFI_EVENT_QUEUE_LENGTH);
+
+// Errors that come from the radio not being in a station mode; retrying
+// cannot fix them.
+bool mode_error(esp_err_t err) {
+  return err == ESP_ERR_INVALID_STATE || err == ESP_ERR_WIFI_NOT_STARTED ||
+         err == ESP_ERR_WIFI_NOT_INIT || err == ESP_ERR_WIFI_MODE;
+}
+
+bool station_mode_active() {
+  wifi_mode_t mode = WIFI_MODE_NULL;
+  return esp_wifi_get_mode(&mode) == ESP_OK &&
+         (mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA);
+}
+
 } // namespace
 
+struct WifiService::EventDispatch {
+  detail::BoundedQueue<WifiEventData, event_queue_length> queue;
+  std::atomic<TaskHandle_t> task{nullptr};
+  std::atomic<uint32_t> dropped{0};
+};
+
 WifiService::WifiService()
     : softap_netif(nullptr), sta_netif(nullptr), wifi_config{}, credentials{},
       initialized(false), handlers_registered(false), sta_connected(false),
@@ -121,7 +274,29 @@ WifiService::WifiService()
       sta_last_disconnect_reason(WIFI_REASON_UNSPECIFIED),
       sta_last_error(ESP_OK), provisioning_active(false),
       current_mode(WifiMode::Off),
-      current_provisioning_mode(ProvisionMode::SmartConfig) {}
+      current_provisioning_mode(ProvisionMode::SmartConfig),
+      event_dispatch(std::make_unique<EventDispatch>()) {}
+
+WifiService::~WifiService() = default;
+
+// Status fields change only inside update_status(), so a snapshot never
+// shows half of a transition.
+template <typename F>
+void WifiService::update_status(F &&mutate) {
+  published_status.write([&](StatusSnapshot &snapshot) {
+    mutate();
+    snapshot.status.mode = current_mode;
+    snapshot.status.sta_connected = sta_connected.load();
+    snapshot.status.sta_connecting = sta_connecting.load();
+    snapshot.status.provisioning_active = provisioning_active.load();
+    snapshot.status.sta_ip = sta_ip.load();
+    snapshot.status.sta_last_disconnect_reason = sta_last_disconnect_reason.load();
+    snapshot.status.sta_last_error = sta_last_error.load();
+    snapshot.status.reconnect_attempts = reconnect_attempt.load();
+    snapshot.status.reconnects_total = reconnect_total.load();
+    snapshot.reconnect_due_us = reconnect_due_us.load();
+  });
+}
 
 esp_err_t WifiService::initialize() {
   if (initialized) {
@@ -199,6 +374,31 @@ esp_err_t WifiService::register_event_handlers() {
     return err;
   }
 
+  err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE,
+                                   &WifiService::wifi_event_handler, this);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED,
+                                 &WifiService::wifi_event_handler);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                 &WifiService::ip_event_handler);
+    return err;
+  }
+
+#if CONFIG_EARBRAIN_TRACE
+  // Only needed to split association from DHCP in the trace.
+  err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED,
+                                   &WifiService::wifi_event_handler, this);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_SCAN_DONE,
+                                 &WifiService::wifi_event_handler);
+    esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED,
+                                 &WifiService::wifi_event_handler);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                 &WifiService::ip_event_handler);
+    return err;
+  }
+#endif
+
   handlers_registered = true;
   return ESP_OK;
 }
@@ -234,15 +434,18 @@ esp_err_t WifiService::start_wifi_sta_mode() {
   }
 
   reset_sta_state();
-  current_mode = WifiMode::STA;
+  update_status([&] { current_mode = WifiMode::STA; });
+  power_profile(power_profile());
   return ESP_OK;
 }
 
 void WifiService::reset_sta_state() {
-  sta_connected = false;
-  sta_last_error = ESP_OK;
-  sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
-  sta_ip.store({.addr = 0});
+  update_status([&] {
+    sta_connected = false;
+    sta_last_error = ESP_OK;
+    sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
+    sta_ip.store({.addr = 0});
+  });
 }
 
 wifi_mode_t WifiService::to_native_mode(WifiMode mode) {
@@ -261,6 +464,7 @@ wifi_mode_t WifiService::to_native_mode(WifiMode mode) {
 
 esp_err_t WifiService::mode(WifiMode new_mode) {
   if (!initialized) return ESP_ERR_INVALID_STATE;
+  EARBRAIN_TRACE_SCOPE("wifi.mode");
 
   // Avoid unnecessary restart if already in the requested mode
   if (current_mode == new_mode && initialized) {
@@ -268,18 +472,34 @@ esp_err_t WifiService::mode(WifiMode new_mode) {
     return ESP_OK;
   }
 
-  esp_err_t stop_err = esp_wifi_stop();
+  // Stopping drops the association; the disconnect event that follows is
+  // ours and must not start the backoff.
+  cancel_reconnect();
+  wifi_ap_record_t ap{};
+  const bool was_associated = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+  if (was_associated) {
+    sta_manual_disconnect.store(true);
+  }
+  esp_err_t stop_err = ESP_OK;
+  {
+    EARBRAIN_TRACE_SCOPE("wifi.esp_wifi_stop");
+    stop_err = esp_wifi_stop();
+  }
   if (stop_err != ESP_OK && stop_err != ESP_ERR_WIFI_NOT_STARTED &&
       stop_err != ESP_ERR_WIFI_NOT_INIT) {
+    if (was_associated) {
+      sta_manual_disconnect.store(false);
+    }
     logging::warnf(wifi_tag, "Failed to stop WiFi before starting: %s",
                    esp_err_to_name(stop_err));
     return stop_err;
   }
+  cancel_reconnect();
 
   wifi_mode_t native_mode = to_native_mode(new_mode);
   if (native_mode == WIFI_MODE_NULL) {
     logging::warn("Requested start with WifiMode::Off; stopping WiFi instead", wifi_tag);
-    current_mode = WifiMode::Off;
+    update_status([&] { current_mode = WifiMode::Off; });
     return ESP_OK;
   }
 
@@ -300,24 +520,29 @@ esp_err_t WifiService::mode(WifiMode new_mode) {
     }
   }
 
-  err = esp_wifi_start();
+  {
+    EARBRAIN_TRACE_SCOPE("wifi.esp_wifi_start");
+    err = esp_wifi_start();
+  }
   if (err != ESP_OK) {
     logging::errorf(wifi_tag, "Failed to start WiFi: %s", esp_err_to_name(err));
     esp_wifi_set_mode(WIFI_MODE_NULL);
     return err;
   }
+  // TX power and the beacon timeout only stick once the radio is up.
+  power_profile(power_profile());
 
   if (native_mode == WIFI_MODE_APSTA) {
-    current_mode = WifiMode::APSTA;
+    update_status([&] { current_mode = WifiMode::APSTA; });
     logging::infof(wifi_tag, "APSTA mode started: %s", wifi_config.ap_config.ssid.c_str());
   } else if (native_mode == WIFI_MODE_AP) {
-    current_mode = WifiMode::AP;
+    update_status([&] { current_mode = WifiMode::AP; });
     logging::infof(wifi_tag, "AP mode started: %s", wifi_config.ap_config.ssid.c_str());
   } else {
-    current_mode = WifiMode::STA;
+    update_status([&] { current_mode = WifiMode::STA; });
     logging::info("STA mode started", wifi_tag);
 
-    auto saved_credentials = load_credentials();
+    auto saved_credentials = pick_network();
     if (saved_credentials.has_value()) {
       logging::infof(wifi_tag, "Auto-connecting to: %s", saved_credentials->ssid.c_str());
       connect(saved_credentials.value());
@@ -328,6 +553,7 @@ esp_err_t WifiService::mode(WifiMode new_mode) {
 }
 
 WifiConfig WifiService::config() const {
+  std::lock_guard<std::mutex> lock(power_mutex);
   return wifi_config;
 }
 
@@ -337,15 +563,151 @@ esp_err_t WifiService::config(const WifiConfig &config) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  wifi_config = config;
+  {
+    std::lock_guard<std::mutex> lock(power_mutex);
+    wifi_config = config;
+  }
   logging::infof(wifi_tag, "AP config updated: %s", wifi_config.ap_config.ssid.c_str());
   logging::info("WiFi config updated", wifi_tag);
+  return power_profile(config.power_profile);
+}
+
+WifiPowerProfile WifiService::power_profile() const {
+  std::lock_guard<std::mutex> lock(power_mutex);
+  return wifi_config.power_profile;
+}
+
+esp_err_t WifiService::power_profile(WifiPowerProfile profile) {
+  std::lock_guard<std::mutex> lock(power_mutex);
+  wifi_config.power_profile = profile;
+  power_idle.store(false);
+  last_activity_us.store(esp_timer_get_time());
+  const esp_err_t err = apply_power(profile);
+  arm_idle_timer();
+  return err;
+}
+
+void WifiService::note_activity() {
+  last_activity_us.store(esp_timer_get_time());
+  if (power_idle.load() && power_idle.exchange(false)) {
+    std::lock_guard<std::mutex> lock(power_mutex);
+    apply_power(wifi_config.power_profile);
+    arm_idle_timer();
+  }
+}
+
+// Callers hold power_mutex.
+WifiPowerSettings WifiService::power_settings(WifiPowerProfile profile) const {
+  return profile == WifiPowerProfile::Custom ? wifi_config.custom_power
+                                             : wifi_power_settings(profile);
+}
+
+// Callers hold power_mutex. Before the radio is started only the listen
+// interval is recorded; mode() applies the rest once it is up.
+esp_err_t WifiService::apply_power(WifiPowerProfile profile) {
+  const WifiPowerSettings settings = power_settings(profile);
+  sta_listen_interval.store(std::max<uint16_t>(settings.listen_interval, 1));
+
+  esp_err_t err = esp_wifi_set_ps(settings.modem_sleep);
+  if (err == ESP_ERR_WIFI_NOT_INIT) {
+    return ESP_OK;
+  }
+  if (err != ESP_OK) {
+    logging::errorf(wifi_tag, "Failed to set modem sleep: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  err = esp_wifi_set_max_tx_power(std::clamp<int8_t>(settings.max_tx_power, 8, 84));
+  if (err == ESP_ERR_WIFI_NOT_STARTED) {
+    return ESP_OK;
+  }
+  if (err != ESP_OK) {
+    logging::errorf(wifi_tag, "Failed to set TX power: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  wifi_mode_t mode = WIFI_MODE_NULL;
+  if (esp_wifi_get_mode(&mode) == ESP_OK && (mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA)) {
+    err = esp_wifi_set_inactive_time(WIFI_IF_STA,
+                                     std::max<uint16_t>(settings.beacon_timeout_s, 3));
+    if (err != ESP_OK) {
+      logging::warnf(wifi_tag, "Failed to set beacon timeout: %s", esp_err_to_name(err));
+    }
+  }
+  logging::infof(wifi_tag, "Power profile %d applied", static_cast<int>(profile));
   return ESP_OK;
 }
 
+// Callers hold power_mutex.
+void WifiService::arm_idle_timer() {
+  if (!wifi_config.idle_power_profile || wifi_config.idle_after_ms == 0) {
+    if (idle_timer) {
+      esp_timer_stop(idle_timer);
+    }
+    return;
+  }
+  if (!idle_timer) {
+    esp_timer_create_args_t args{};
+    args.callback = &WifiService::on_idle_timer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "wifi_idle";
+    if (esp_timer_create(&args, &idle_timer) != ESP_OK) {
+      idle_timer = nullptr;
+      return;
+    }
+  }
+  esp_timer_stop(idle_timer);
+  esp_timer_start_once(idle_timer, static_cast<uint64_t>(wifi_config.idle_after_ms) * 1000);
+}
+
+// note_activity() only stamps the time; the timer works out whether the
+// whole idle period really passed and otherwise waits for the rest of it.
+void WifiService::on_idle_timer(void *arg) {
+  auto *self = static_cast<WifiService *>(arg);
+  std::lock_guard<std::mutex> lock(self->power_mutex);
+  const WifiConfig &config = self->wifi_config;
+  if (!config.idle_power_profile || self->power_idle.load()) {
+    return;
+  }
+  const int64_t idle_us = static_cast<int64_t>(config.idle_after_ms) * 1000;
+  const int64_t elapsed = esp_timer_get_time() - self->last_activity_us.load();
+  if (elapsed < idle_us) {
+    esp_timer_start_once(self->idle_timer, static_cast<uint64_t>(idle_us - elapsed));
+    return;
+  }
+  self->power_idle.store(true);
+  self->apply_power(*config.idle_power_profile);
+}
+
 esp_err_t WifiService::connect(const WifiCredentials &creds) {
-  if (!initialized) return ESP_ERR_INVALID_STATE;
+  return begin_connect(creds, nullptr);
+}
 
+// With `result`, it receives a future for the attempt this call starts.
+esp_err_t WifiService::begin_connect(const WifiCredentials &creds,
+                                     Future<esp_err_t> *result) {
+  if (!initialized) {
+    if (result) *result = make_ready_future<esp_err_t>(ESP_ERR_INVALID_STATE);
+    return ESP_ERR_INVALID_STATE;
+  }
+  EARBRAIN_TRACE_SCOPE("wifi.connect");
+
+  // An explicit connect starts the backoff over.
+  cancel_reconnect();
+  const uint32_t attempt = begin_attempt();
+  if (result) {
+    // Registered first so that an immediate IP event cannot be missed.
+    *result = track_connect(attempt);
+  }
+  const esp_err_t err = start_connect(creds);
+  if (err != ESP_OK) {
+    settle_connects(attempt, err);
+  }
+  return err;
+}
+
+esp_err_t WifiService::start_connect(const WifiCredentials &creds) {
   esp_err_t validation_err = validate_station_config(creds);
   if (validation_err != ESP_OK) {
     emit_connection_failed(validation_err);
@@ -365,7 +727,7 @@ esp_err_t WifiService::connect(const WifiCredentials &creds) {
     return ESP_ERR_INVALID_STATE;
   }
 
-  sta_connecting.store(true);
+  update_status([&] { sta_connecting.store(true); });
 
   // Only disconnect if currently connected
   bool was_connected = false;
@@ -375,12 +737,29 @@ esp_err_t WifiService::connect(const WifiCredentials &creds) {
   }
 
   if (was_connected) {
+    EARBRAIN_TRACE_SCOPE("wifi.esp_wifi_disconnect");
     sta_manual_disconnect.store(true);
     esp_wifi_disconnect();
   }
 
-  wifi_config_t sta_cfg = make_sta_config(creds);
-  err = esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+  wifi_config_t sta_cfg = make_sta_config(creds, sta_listen_interval.load());
+  const bool fast = apply_fast_connect(creds, sta_cfg);
+#if CONFIG_ESP_WIFI_NVS_ENABLED
+  // The BSSID pin and PMK are for this attempt only; keep them out of the
+  // configuration the driver saves in flash.
+  if (fast) {
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+  }
+#endif
+  {
+    EARBRAIN_TRACE_SCOPE("wifi.set_config");
+    err = esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+  }
+#if CONFIG_ESP_WIFI_NVS_ENABLED
+  if (fast) {
+    esp_wifi_set_storage(driver_storage.load());
+  }
+#endif
   if (err != ESP_OK) {
     logging::errorf(wifi_tag, "Failed to configure STA interface: %s",
                     esp_err_to_name(err));
@@ -388,27 +767,415 @@ esp_err_t WifiService::connect(const WifiCredentials &creds) {
     return err;
   }
 
-  err = esp_wifi_connect();
+  fast_attempt.store(fast);
+  connect_started_us.store(esp_timer_get_time());
+  associated_us.store(0);
+  {
+    EARBRAIN_TRACE_SCOPE("wifi.esp_wifi_connect");
+    err = esp_wifi_connect();
+  }
   if (err != ESP_OK && err != ESP_ERR_WIFI_CONN) {
     logging::errorf(wifi_tag, "Failed to initiate connection: %s",
                     esp_err_to_name(err));
+    fast_attempt.store(false);
     emit_connection_failed(err);
     return err;
   }
-
+  // Only once the attempt is under way, so a failed call keeps the last
+  // credentials that worked for reconnects.
   credentials = creds;
-  sta_connected = false;
-  sta_last_error = ESP_OK;
-  sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
-  sta_ip.store({.addr = 0});
+
+  reset_sta_state();
   logging::infof(wifi_tag,
-                 "Connection initiated: ssid='%s', passphrase_len=%zu",
-                 credentials.ssid.c_str(), credentials.passphrase.size());
+                 "Connection initiated: ssid='%s', passphrase_len=%zu%s",
+                 credentials.ssid.c_str(), credentials.passphrase.size(),
+                 fast ? " (fast)" : "");
+  return ESP_OK;
+}
+
+esp_err_t WifiService::storage(wifi_storage_t storage) {
+  const esp_err_t err = esp_wifi_set_storage(storage);
+  if (err == ESP_OK) {
+    driver_storage.store(storage);
+  }
+  return err;
+}
+
+WifiReconnectPolicy WifiService::reconnect_policy() const {
+  std::lock_guard<std::mutex> lock(reconnect_mutex);
+  return reconnect_settings;
+}
+
+esp_err_t WifiService::reconnect_policy(const WifiReconnectPolicy &policy) {
+  if (policy.initial_delay_ms == 0 || policy.max_delay_ms < policy.initial_delay_ms ||
+      policy.jitter_percent > 100) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  {
+    std::lock_guard<std::mutex> lock(reconnect_mutex);
+    reconnect_settings = policy;
+  }
+  if (!policy.enabled) {
+    cancel_reconnect();
+  }
   return ESP_OK;
 }
 
+// `generation` is the reconnect_generation the caller saw when it decided
+// to retry; a cancel since then wins.
+// Returns whether a retry is armed.
+bool WifiService::schedule_reconnect(wifi_err_reason_t reason, uint32_t generation) {
+  std::lock_guard<std::mutex> lock(reconnect_mutex);
+  const WifiReconnectPolicy &policy = reconnect_settings;
+  if (!policy.enabled || credentials.ssid.empty() || provisioning_active.load() ||
+      generation != reconnect_generation.load() || !station_mode_active()) {
+    return false;
+  }
+
+  const uint32_t attempt = reconnect_attempt.load();
+  if (policy.max_attempts != 0 && attempt >= policy.max_attempts) {
+    logging::warnf(wifi_tag, "Giving up reconnecting after %lu attempts",
+                   static_cast<unsigned long>(attempt));
+    return false;
+  }
+
+  uint64_t delay_ms = policy.initial_delay_ms;
+  for (uint32_t i = 0; i < attempt && delay_ms < policy.max_delay_ms; ++i) {
+    delay_ms *= 2;
+  }
+  delay_ms = std::min<uint64_t>(delay_ms, policy.max_delay_ms);
+  switch (reason) {
+  case WIFI_REASON_AUTH_FAIL:
+  case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+  case WIFI_REASON_HANDSHAKE_TIMEOUT:
+    delay_ms = std::max<uint64_t>(delay_ms, policy.auth_fail_delay_ms);
+    break;
+  default:
+    break;
+  }
+  if (policy.jitter_percent != 0) {
+    const uint64_t spread = delay_ms * policy.jitter_percent / 100;
+    delay_ms = delay_ms - spread + esp_random() % (2 * spread + 1);
+  }
+
+  if (!reconnect_timer) {
+    esp_timer_create_args_t args{};
+    args.callback = &WifiService::on_reconnect_timer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "wifi_reconnect";
+    if (esp_timer_create(&args, &reconnect_timer) != ESP_OK) {
+      reconnect_timer = nullptr;
+      logging::warn("Failed to create reconnect timer", wifi_tag);
+      return false;
+    }
+  }
+
+  esp_timer_stop(reconnect_timer);
+  if (esp_timer_start_once(reconnect_timer, delay_ms * 1000) != ESP_OK) {
+    return false;
+  }
+  update_status([&] {
+    reconnect_attempt.store(attempt + 1);
+    reconnect_due_us.store(esp_timer_get_time() + static_cast<int64_t>(delay_ms) * 1000);
+  });
+  logging::infof(wifi_tag, "Reconnecting in %llu ms (attempt %lu)",
+                 static_cast<unsigned long long>(delay_ms),
+                 static_cast<unsigned long>(attempt + 1));
+  return true;
+}
+
+void WifiService::cancel_reconnect() {
+  bool was_retrying = false;
+  {
+    std::lock_guard<std::mutex> lock(reconnect_mutex);
+    reconnect_generation.fetch_add(1);
+    if (reconnect_timer) {
+      esp_timer_stop(reconnect_timer);
+    }
+    update_status([&] {
+      was_retrying = reconnect_attempt.exchange(0) != 0;
+      reconnect_due_us.store(0);
+    });
+  }
+  // A backoff that is called off ends its attempt with the last failure.
+  if (was_retrying) {
+    settle_connects(connect_attempt.load(), sta_last_error.load());
+  }
+}
+
+// Runs on the shared esp_timer task, so the attempt itself, with its NVS
+// reads and driver calls, is handed to the pool.
+void WifiService::on_reconnect_timer(void *arg) {
+  auto *self = static_cast<WifiService *>(arg);
+  const uint32_t generation = self->reconnect_generation.load();
+  self->update_status([&] {
+    self->reconnect_due_us.store(0);
+    self->reconnect_total.fetch_add(1);
+  });
+
+  if (tasks::pool().submit([self, generation]() { self->run_reconnect(generation); }) !=
+      ESP_OK) {
+    // The pool is full or down; try again at the next step.
+    if (!self->schedule_reconnect(WIFI_REASON_UNSPECIFIED, generation)) {
+      self->settle_connects(self->connect_attempt.load(), self->sta_last_error.load());
+    }
+  }
+}
+
+void WifiService::run_reconnect(uint32_t generation) {
+  const uint32_t attempt = connect_attempt.load();
+  if (generation != reconnect_generation.load()) {
+    return;
+  }
+  if (!station_mode_active()) {
+    cancel_reconnect();
+    return;
+  }
+
+  // After repeated failures the device has probably moved, so look for
+  // another known network. The driver cannot scan while the station is
+  // connecting, so without a fresh scan this step scans instead and
+  // reconnects once it is done.
+  WifiCredentials creds = credentials;
+  if (reconnect_attempt.load() >= 2 && credential_store.size() > 1) {
+    if (!fresh_scan()) {
+      roam(generation);
+      return;
+    }
+    creds = pick_network().value_or(credentials);
+  }
+  retry_connect(generation, attempt, creds);
+}
+
+void WifiService::roam(uint32_t generation) {
+  // A roaming scan already in flight reconnects for this step instead.
+  roam_generation.store(generation);
+  if (roam_scanning.exchange(true)) {
+    return;
+  }
+  roam_records.resize(roam_scan_capacity);
+  scan_async(std::span<wifi_ap_record_t>(roam_records))
+      .then([this](WifiScanOutcome outcome) {
+        finish_roam(outcome);
+        return outcome.error;
+      });
+}
+
+void WifiService::finish_roam(const WifiScanOutcome &outcome) {
+  const uint32_t attempt = connect_attempt.load();
+  WifiCredentials creds = credentials;
+  if (outcome.error == ESP_OK) {
+    WifiScanResult scan = summarize_scan(
+        std::span<const wifi_ap_record_t>(roam_records.data(), outcome.count));
+    if (auto best = credential_store.best_match(scan)) {
+      creds = WifiCredentials{std::move(best->ssid), std::move(best->passphrase)};
+    }
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    scan_cache = CachedScan{WifiScanOptions{}, std::move(scan), esp_timer_get_time()};
+  } else {
+    logging::warnf(wifi_tag, "Roaming scan failed: %s", esp_err_to_name(outcome.error));
+  }
+  roam_records.clear();
+  roam_records.shrink_to_fit();
+  roam_scanning.store(false);
+
+  const uint32_t generation = roam_generation.load();
+  if (generation != reconnect_generation.load()) {
+    return;
+  }
+  if (!station_mode_active()) {
+    cancel_reconnect();
+    return;
+  }
+  retry_connect(generation, attempt, creds);
+}
+
+void WifiService::retry_connect(uint32_t generation, uint32_t attempt,
+                                const WifiCredentials &creds) {
+  if (creds.ssid != credentials.ssid) {
+    logging::infof(wifi_tag, "Roaming to known network '%s'", creds.ssid.c_str());
+  }
+  const esp_err_t err = start_connect(creds);
+  if (mode_error(err)) {
+    cancel_reconnect();
+  } else if (err != ESP_OK) {
+    // No disconnect event will follow, so keep the backoff going here.
+    if (!schedule_reconnect(WIFI_REASON_UNSPECIFIED, generation)) {
+      settle_connects(attempt, err);
+    }
+  }
+}
+
+bool WifiService::apply_fast_connect(const WifiCredentials &creds,
+                                     wifi_config_t &sta_cfg) {
+#if CONFIG_EARBRAIN_WIFI_FAST_CONNECT
+  std::lock_guard<std::mutex> lock(fast_connect_mutex);
+  load_fast_record();
+  if (!fast_record || fast_record->channel == 0 || creds.ssid != fast_record->ssid ||
+      hash_passphrase(creds.passphrase) != fast_record->passphrase_hash) {
+    return false;
+  }
+
+  sta_cfg.sta.scan_method = WIFI_FAST_SCAN;
+  sta_cfg.sta.channel = fast_record->channel;
+  sta_cfg.sta.bssid_set = true;
+  std::memcpy(sta_cfg.sta.bssid, fast_record->bssid, sizeof(sta_cfg.sta.bssid));
+  if (fast_record->has_pmk && pmk_usable(fast_record->auth_mode)) {
+    // A 64-digit hex password is taken as the PSK itself, which skips the
+    // 4096-round PBKDF2 on every connect.
+    static constexpr char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < sizeof(fast_record->pmk); ++i) {
+      sta_cfg.sta.password[2 * i] = digits[fast_record->pmk[i] >> 4];
+      sta_cfg.sta.password[2 * i + 1] = digits[fast_record->pmk[i] & 0x0f];
+    }
+  }
+  return true;
+#else
+  (void)creds;
+  (void)sta_cfg;
+  return false;
+#endif
+}
+
+void WifiService::remember_fast_connect() {
+#if CONFIG_EARBRAIN_WIFI_FAST_CONNECT
+  wifi_ap_record_t ap{};
+  if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+    return;
+  }
+  WifiCredentials creds = credentials;
+  const char *ap_ssid = reinterpret_cast<const char *>(ap.ssid);
+  // Provisioning connects without going through connect(); skip those.
+  if (creds.ssid.empty() || creds.ssid != std::string_view(ap_ssid, strnlen(ap_ssid, 32))) {
+    return;
+  }
+
+  // The record is read from and written to NVS and the PMK takes a
+  // 4096-round PBKDF2; none of that belongs on the event loop task.
+  tasks::pool().submit(
+      [this, creds = std::move(creds), ap]() { update_fast_record(creds, ap); });
+#endif
+}
+
+#if CONFIG_EARBRAIN_WIFI_FAST_CONNECT
+void WifiService::update_fast_record(const WifiCredentials &creds,
+                                     const wifi_ap_record_t &ap) {
+  const uint32_t hash = hash_passphrase(creds.passphrase);
+  bool derive_pmk = false;
+  {
+    std::lock_guard<std::mutex> lock(fast_connect_mutex);
+    load_fast_record();
+    const bool same_network = fast_record && creds.ssid == fast_record->ssid &&
+                              hash == fast_record->passphrase_hash;
+    FastConnect next = same_network ? *fast_record : FastConnect{};
+    const bool changed = !same_network ||
+                         std::memcmp(next.bssid, ap.bssid, sizeof(next.bssid)) != 0 ||
+                         next.channel != ap.primary || next.auth_mode != ap.authmode;
+
+    std::memcpy(next.ssid, creds.ssid.data(), std::min(creds.ssid.size(), size_t(32)));
+    next.passphrase_hash = hash;
+    std::memcpy(next.bssid, ap.bssid, sizeof(next.bssid));
+    next.channel = ap.primary;
+    next.auth_mode = ap.authmode;
+    if (!pmk_usable(next.auth_mode)) {
+      next.has_pmk = false;
+    }
+    // A 64-digit passphrase already is the PSK.
+    derive_pmk = !next.has_pmk && pmk_usable(next.auth_mode) &&
+                 !creds.passphrase.empty() && creds.passphrase.size() < 64;
+
+    fast_record = next;
+    if (changed) {
+      store_fast_record();
+    }
+  }
+
+  if (!derive_pmk) {
+    return;
+  }
+  uint8_t pmk[32];
+  if (mbedtls_pkcs5_pbkdf2_hmac_ext(
+          MBEDTLS_MD_SHA1, reinterpret_cast<const unsigned char *>(creds.passphrase.data()),
+          creds.passphrase.size(), reinterpret_cast<const unsigned char *>(creds.ssid.data()),
+          creds.ssid.size(), 4096, sizeof(pmk), pmk) != 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(fast_connect_mutex);
+  if (fast_record && creds.ssid == fast_record->ssid &&
+      hash == fast_record->passphrase_hash) {
+    std::memcpy(fast_record->pmk, pmk, sizeof(pmk));
+    fast_record->has_pmk = true;
+    store_fast_record();
+  }
+}
+#endif
+
+// Called on the event loop task: the record is dropped in memory at once
+// and the NVS write goes to the pool. The job stores whatever the record is
+// by then, so jobs running out of order still leave the newest state.
+void WifiService::forget_fast_connect() {
+  {
+    std::lock_guard<std::mutex> lock(fast_connect_mutex);
+    fast_record.reset();
+    fast_record_loaded = true;
+  }
+  tasks::pool().submit([this]() {
+    std::lock_guard<std::mutex> lock(fast_connect_mutex);
+    store_fast_record();
+  });
+}
+
+// Callers hold fast_connect_mutex.
+void WifiService::load_fast_record() {
+  if (fast_record_loaded) {
+    return;
+  }
+  fast_record_loaded = true;
+
+  nvs_handle_t handle;
+  if (nvs_open(fast_connect_namespace, NVS_READONLY, &handle) != ESP_OK) {
+    return;
+  }
+  FastConnect stored{};
+  size_t size = sizeof(stored);
+  if (nvs_get_blob(handle, fast_connect_key, &stored, &size) == ESP_OK &&
+      size == sizeof(stored) && stored.version == FastConnect{}.version) {
+    stored.ssid[sizeof(stored.ssid) - 1] = '\0';
+    fast_record = stored;
+  }
+  nvs_close(handle);
+}
+
+// Callers hold fast_connect_mutex.
+void WifiService::store_fast_record() {
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(fast_connect_namespace, NVS_READWRITE, &handle);
+  if (err != ESP_OK) {
+    logging::warnf(wifi_tag, "Failed to open fast connect storage: %s",
+                   esp_err_to_name(err));
+    return;
+  }
+  if (fast_record) {
+    err = nvs_set_blob(handle, fast_connect_key, &*fast_record, sizeof(FastConnect));
+  } else {
+    err = nvs_erase_key(handle, fast_connect_key);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+      err = ESP_OK;
+    }
+  }
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  if (err != ESP_OK) {
+    logging::warnf(wifi_tag, "Failed to save fast connect record: %s",
+                   esp_err_to_name(err));
+  }
+  nvs_close(handle);
+}
+
 esp_err_t WifiService::save_credentials(std::string_view ssid,
-                                        std::string_view passphrase) {
+                                        std::string_view passphrase, uint8_t priority) {
   if (!initialized) return ESP_ERR_INVALID_STATE;
 
   WifiCredentials creds{std::string(ssid), std::string(passphrase)};
@@ -417,26 +1184,9 @@ esp_err_t WifiService::save_credentials(std::string_view ssid,
     return validation_err;
   }
 
-  wifi_config_t sta_config = {};
-
-  // Copy SSID (max 32 bytes)
-  size_t ssid_len = std::min(ssid.length(), sizeof(sta_config.sta.ssid) - 1);
-  std::memcpy(sta_config.sta.ssid, ssid.data(), ssid_len);
-  sta_config.sta.ssid[ssid_len] = '\0';
-
-  // Copy passphrase (max 64 bytes)
-  size_t pass_len =
-      std::min(passphrase.length(), sizeof(sta_config.sta.password) - 1);
-  std::memcpy(sta_config.sta.password, passphrase.data(), pass_len);
-  sta_config.sta.password[pass_len] = '\0';
-
-  // Set the WiFi configuration which will be stored in NVS
-  esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &sta_config);
-
+  esp_err_t err = credential_store.save(
+      KnownNetwork{std::move(creds.ssid), std::move(creds.passphrase), priority});
   if (err == ESP_OK) {
-    // Cache the credentials
-    cached_credentials = WifiCredentials{.ssid = std::string(ssid),
-                                         .passphrase = std::string(passphrase)};
     logging::infof(wifi_tag, "Saved Wi-Fi credentials for SSID: %s",
                    std::string(ssid).c_str());
   } else {
@@ -450,11 +1200,16 @@ esp_err_t WifiService::save_credentials(std::string_view ssid,
 std::optional<WifiCredentials> WifiService::load_credentials() {
   if (!initialized) return std::nullopt;
 
-  if (cached_credentials.has_value()) {
-    return cached_credentials;
+  if (auto top = credential_store.top()) {
+    return WifiCredentials{std::move(top->ssid), std::move(top->passphrase)};
+  }
+  if (driver_credentials_imported) {
+    return std::nullopt;
   }
+  driver_credentials_imported = true;
 
-  // Load from NVS
+  // Older firmware kept a single network in the driver's own config; move
+  // it into the store once.
   wifi_config_t sta_config = {};
   esp_err_t err = esp_wifi_get_config(WIFI_IF_STA, &sta_config);
 
@@ -470,31 +1225,133 @@ std::optional<WifiCredentials> WifiService::load_credentials() {
     return std::nullopt;
   }
 
-  // Convert to WifiCredentials and cache it
   WifiCredentials loaded;
-  loaded.ssid =
-      std::string(reinterpret_cast<const char *>(sta_config.sta.ssid));
-  loaded.passphrase =
-      std::string(reinterpret_cast<const char *>(sta_config.sta.password));
-
-  cached_credentials = loaded;
-  logging::infof(wifi_tag, "Loaded saved Wi-Fi credentials for SSID: %s",
+  loaded.ssid = std::string(
+      reinterpret_cast<const char *>(sta_config.sta.ssid),
+      strnlen(reinterpret_cast<const char *>(sta_config.sta.ssid), sizeof(sta_config.sta.ssid)));
+  loaded.passphrase = std::string(
+      reinterpret_cast<const char *>(sta_config.sta.password),
+      strnlen(reinterpret_cast<const char *>(sta_config.sta.password),
+              sizeof(sta_config.sta.password)));
+
+  credential_store.save(KnownNetwork{loaded.ssid, loaded.passphrase});
+  logging::infof(wifi_tag, "Imported saved Wi-Fi credentials for SSID: %s",
                  loaded.ssid.c_str());
 
   return loaded;
 }
 
-esp_err_t WifiService::connect() {
-  if (!initialized) return ESP_ERR_INVALID_STATE;
+esp_err_t WifiService::forget_credentials(std::string_view ssid) {
+  return credential_store.remove(ssid);
+}
+
+// With several known networks, a fresh scan-cache entry decides which of
+// them to join. This never goes on air: without one, or when none of them
+// shows up (e.g. hidden ones), it falls back to the top of the ranking and
+// the reconnect backoff roams once that fails.
+std::optional<WifiCredentials> WifiService::pick_network() {
+  if (credential_store.size() > 1) {
+    if (auto scan = fresh_scan()) {
+      if (auto best = credential_store.best_match(*scan)) {
+        return WifiCredentials{std::move(best->ssid), std::move(best->passphrase)};
+      }
+    }
+  }
+  return load_credentials();
+}
+
+// A cached sweep of every channel without a target, young enough to rank by.
+std::optional<WifiScanResult> WifiService::fresh_scan() const {
+  std::lock_guard<std::mutex> lock(scan_mutex);
+  if (!scan_cache || scan_cache->options.channels != 0 ||
+      !scan_cache->options.ssid.empty() || scan_cache->options.bssid ||
+      esp_timer_get_time() - scan_cache->taken_us >
+          static_cast<int64_t>(CONFIG_EARBRAIN_WIFI_SCAN_CACHE_TTL_MS) * 1000) {
+    return std::nullopt;
+  }
+  return scan_cache->result;
+}
+
+esp_err_t WifiService::connect() { return begin_connect(nullptr); }
+
+esp_err_t WifiService::begin_connect(Future<esp_err_t> *result) {
+  if (!initialized) {
+    if (result) *result = make_ready_future<esp_err_t>(ESP_ERR_INVALID_STATE);
+    return ESP_ERR_INVALID_STATE;
+  }
 
-  auto saved_credentials = load_credentials();
+  auto saved_credentials = pick_network();
   if (!saved_credentials.has_value()) {
     logging::warn("No saved credentials found", wifi_tag);
     emit_connection_failed(ESP_ERR_NOT_FOUND);
+    if (result) *result = make_ready_future<esp_err_t>(ESP_ERR_NOT_FOUND);
     return ESP_ERR_NOT_FOUND;
   }
 
-  return connect(saved_credentials.value());
+  return begin_connect(saved_credentials.value(), result);
+}
+
+Future<esp_err_t> WifiService::connect_async(const WifiCredentials &creds) {
+  Future<esp_err_t> result;
+  begin_connect(creds, &result);
+  return result;
+}
+
+Future<esp_err_t> WifiService::connect_async() {
+  // Join an attempt that is already running, e.g. the auto-connect started
+  // by mode(), instead of restarting it.
+  if (sta_connecting.load()) {
+    return track_connect(connect_attempt.load());
+  }
+  if (sta_connected.load()) {
+    return make_ready_future<esp_err_t>(ESP_OK);
+  }
+  Future<esp_err_t> result;
+  begin_connect(&result);
+  return result;
+}
+
+// Futures still waiting on an earlier attempt have nothing left to wait
+// for once a new one starts.
+uint32_t WifiService::begin_attempt() {
+  const uint32_t attempt = connect_attempt.fetch_add(1) + 1;
+  std::vector<PendingConnect> replaced;
+  {
+    std::lock_guard<std::mutex> lock(pending_connects_mutex);
+    auto first = std::stable_partition(
+        pending_connects.begin(), pending_connects.end(), [&](const PendingConnect &pending) {
+          return static_cast<int32_t>(attempt - pending.attempt) <= 0;
+        });
+    std::move(first, pending_connects.end(), std::back_inserter(replaced));
+    pending_connects.erase(first, pending_connects.end());
+  }
+  for (auto &pending : replaced) {
+    pending.promise.set(ESP_ERR_INVALID_STATE);
+  }
+  return attempt;
+}
+
+Future<esp_err_t> WifiService::track_connect(uint32_t attempt) {
+  Promise<esp_err_t> promise;
+  Future<esp_err_t> result = promise.future();
+  std::lock_guard<std::mutex> lock(pending_connects_mutex);
+  pending_connects.push_back(PendingConnect{attempt, std::move(promise)});
+  return result;
+}
+
+void WifiService::settle_connects(uint32_t attempt, esp_err_t result) {
+  std::vector<PendingConnect> settled;
+  {
+    std::lock_guard<std::mutex> lock(pending_connects_mutex);
+    auto first = std::stable_partition(
+        pending_connects.begin(), pending_connects.end(),
+        [&](const PendingConnect &pending) { return pending.attempt != attempt; });
+    std::move(first, pending_connects.end(), std::back_inserter(settled));
+    pending_connects.erase(first, pending_connects.end());
+  }
+  for (auto &pending : settled) {
+    pending.promise.set(result);
+  }
 }
 
 void WifiService::ip_event_handler(void *arg, esp_event_base_t event_base,
@@ -522,6 +1379,12 @@ void WifiService::wifi_event_handler(void *arg, esp_event_base_t event_base,
   }
 
   switch (event_id) {
+  case WIFI_EVENT_STA_CONNECTED: {
+    const int64_t now_us = esp_timer_get_time();
+    trace::record("wifi.associate", wifi->connect_started_us.load(), now_us);
+    wifi->associated_us.store(now_us);
+    break;
+  }
   case WIFI_EVENT_STA_DISCONNECTED:
     if (event_data) {
       const auto *event =
@@ -529,20 +1392,33 @@ void WifiService::wifi_event_handler(void *arg, esp_event_base_t event_base,
       wifi->on_sta_disconnected(*event);
     }
     break;
+  case WIFI_EVENT_SCAN_DONE:
+    if (event_data) {
+      const auto *event = static_cast<wifi_event_sta_scan_done_t *>(event_data);
+      wifi->on_scan_done(*event);
+    }
+    break;
   default:
     break;
   }
 }
 
 void WifiService::on_sta_got_ip(const ip_event_got_ip_t &event) {
-  sta_connected = true;
-  sta_last_error = ESP_OK;
-  sta_ip.store(event.ip_info.ip);
-  sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
+  EARBRAIN_TRACE_SCOPE("wifi.on_sta_got_ip");
+  const int64_t got_ip_us = esp_timer_get_time();
+  trace::record("wifi.dhcp", associated_us.exchange(0), got_ip_us);
 
-  if (sta_connecting.load()) {
-    sta_connecting.store(false);
+  bool was_connecting = false;
+  update_status([&] {
+    sta_connected = true;
+    sta_last_error = ESP_OK;
+    sta_ip.store(event.ip_info.ip);
+    sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
+    was_connecting = sta_connecting.exchange(false);
+    reconnect_attempt.store(0);
+  });
 
+  if (was_connecting) {
     if (provisioning_active.load() && temp_provisioning_credentials.has_value()) {
       esp_err_t err = save_credentials(temp_provisioning_credentials->ssid,
                                        temp_provisioning_credentials->passphrase);
@@ -554,7 +1430,10 @@ void WifiService::on_sta_got_ip(const ip_event_got_ip_t &event) {
         event_data.sta_connecting = sta_connecting.load();
         event_data.provisioning_active = provisioning_active.load();
         event_data.event = WifiEvent::ProvisioningCompleted;
-        event_data.credentials = temp_provisioning_credentials;
+        if (wants(WifiEvent::ProvisioningCompleted)) {
+          event_data.credentials =
+              make_tracked_shared<WifiCredentials>(*temp_provisioning_credentials);
+        }
         event_data.ip_address = event.ip_info.ip;
         emit(event_data);
 
@@ -579,31 +1458,66 @@ void WifiService::on_sta_got_ip(const ip_event_got_ip_t &event) {
   event_data.provisioning_active = provisioning_active.load();
   event_data.event = WifiEvent::Connected;
   event_data.ip_address = event.ip_info.ip;
+  event_data.fast_connect = fast_attempt.exchange(false);
+  if (const int64_t started = connect_started_us.exchange(0); started != 0) {
+    event_data.time_to_ip_ms = static_cast<uint32_t>((got_ip_us - started) / 1000);
+    trace::record("wifi.time_to_ip", started, got_ip_us);
+  }
   emit(event_data);
+  settle_connects(connect_attempt.load(), ESP_OK);
+  remember_fast_connect();
 
   esp_ip4_addr_t ip = sta_ip.load();
-  logging::infof(wifi_tag, "Station got IP: %s", ip_to_string(ip).c_str());
+  if (event_data.time_to_ip_ms) {
+    logging::infof(wifi_tag, "Station got IP: %s (%lu ms%s)", ip_to_string(ip).c_str(),
+                   static_cast<unsigned long>(*event_data.time_to_ip_ms),
+                   event_data.fast_connect ? ", fast" : "");
+  } else {
+    logging::infof(wifi_tag, "Station got IP: %s", ip_to_string(ip).c_str());
+  }
 }
 
 void WifiService::on_sta_disconnected(
     const wifi_event_sta_disconnected_t &event) {
-  sta_connected = false;
-  sta_ip.store({.addr = 0});
+  const uint32_t generation = reconnect_generation.load();
+  const uint32_t attempt = connect_attempt.load();
+  update_status([&] {
+    sta_connected = false;
+    sta_ip.store({.addr = 0});
+  });
   const bool manual = sta_manual_disconnect.exchange(false);
 
   if (manual && event.reason == WIFI_REASON_ASSOC_LEAVE) {
-    sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
-    sta_last_error = ESP_OK;
+    update_status([&] {
+      sta_last_disconnect_reason = WIFI_REASON_UNSPECIFIED;
+      sta_last_error = ESP_OK;
+    });
     logging::info("Station disconnected intentionally (manual reconnect)", wifi_tag);
     return;
   }
 
-  sta_last_disconnect_reason = static_cast<wifi_err_reason_t>(event.reason);
+  // The cached AP did not work out; retry once the normal way before
+  // reporting anything.
+  if (sta_connecting.load() && fast_attempt.exchange(false)) {
+    logging::infof(wifi_tag, "Fast connect failed (reason=%d), falling back to full scan",
+                   static_cast<int>(event.reason));
+    forget_fast_connect();
+    wifi_config_t sta_cfg = make_sta_config(credentials, sta_listen_interval.load());
+    if (esp_wifi_set_config(WIFI_IF_STA, &sta_cfg) == ESP_OK &&
+        esp_wifi_connect() == ESP_OK) {
+      return;
+    }
+  }
 
-  if (sta_connecting.load()) {
-    sta_connecting.store(false);
-    esp_err_t error = ESP_FAIL;
-    switch (sta_last_disconnect_reason) {
+  bool was_connecting = false;
+  update_status([&] {
+    sta_last_disconnect_reason = static_cast<wifi_err_reason_t>(event.reason);
+    was_connecting = sta_connecting.exchange(false);
+  });
+
+  esp_err_t error = ESP_FAIL;
+  if (was_connecting) {
+    switch (static_cast<wifi_err_reason_t>(event.reason)) {
     case WIFI_REASON_AUTH_FAIL:
       error = ESP_ERR_WIFI_PASSWORD;
       break;
@@ -633,9 +1547,23 @@ void WifiService::on_sta_disconnected(
 
   logging::warnf(wifi_tag, "Station disconnected (reason=%d)",
                  static_cast<int>(event.reason));
+
+  // Listeners run later on the event task. One that calls connect() cancels
+  // the reconnect, which bumps the generation taken above, so either it
+  // lands first and this is skipped, or it stops the timer armed here.
+  if (!schedule_reconnect(static_cast<wifi_err_reason_t>(event.reason), generation) &&
+      was_connecting) {
+    // Nothing will retry, so this failure is how the attempt ended.
+    settle_connects(attempt, error);
+  }
 }
 
 WifiScanResult WifiService::perform_scan() const {
+  return perform_scan(WifiScanOptions{});
+}
+
+WifiScanResult WifiService::perform_scan(const WifiScanOptions &options) const {
+  EARBRAIN_TRACE_SCOPE("wifi.perform_scan");
   WifiScanResult result{};
 
   // WiFi must be started before scanning
@@ -647,94 +1575,244 @@ WifiScanResult WifiService::perform_scan() const {
     return result;
   }
 
-  // Start scan
-  wifi_scan_config_t scan_cfg{};
-  scan_cfg.show_hidden = true;
-
-  err = esp_wifi_scan_start(&scan_cfg, true);
-  if (err != ESP_OK) {
-    result.error = err;
+  if ((options.channels & ~WifiScanOptions::valid_channels) != 0) {
+    result.error = ESP_ERR_INVALID_ARG;
+    logging::warn("Cannot scan: channel outside 1-14 requested", wifi_tag);
     return result;
   }
 
-  // Get scan results
-  uint16_t ap_count = 0;
-  err = esp_wifi_scan_get_ap_num(&ap_count);
-  std::vector<wifi_ap_record_t> records;
-  if (err == ESP_OK && ap_count > 0) {
-    records.resize(ap_count);
-    err = esp_wifi_scan_get_ap_records(&ap_count, records.data());
-    if (err == ESP_OK) {
-      records.resize(ap_count);
+  bool cached = false;
+  {
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    if (options.max_age_ms > 0 && scan_cache && same_scan(scan_cache->options, options) &&
+        esp_timer_get_time() - scan_cache->taken_us <=
+            static_cast<int64_t>(options.max_age_ms) * 1000) {
+      result = scan_cache->result;
+      cached = true;
+    } else if (scan_job || blocking_scan) {
+      result.error = ESP_ERR_INVALID_STATE;
+      logging::warn("Cannot scan: another scan is in progress", wifi_tag);
+      return result;
     } else {
-      records.clear();
+      blocking_scan = true;
     }
   }
 
+  if (cached) {
+    // Connection state may have moved on since the cached scan.
+    for (auto &summary : result.networks) {
+      summary.connected = sta_connected && !credentials.ssid.empty() &&
+                          credentials.ssid == summary.ssid;
+    }
+    return result;
+  }
+
+  uint16_t passes = options.channels;
+  if (options.per_channel && passes == 0) {
+    passes = country_channels();
+  }
+
+  std::vector<wifi_ap_record_t, TrackedAllocator<wifi_ap_record_t, MemoryTag::Wifi>> records;
+  do {
+    const uint8_t channel = passes ? static_cast<uint8_t>(std::countr_zero(passes)) : 0;
+    passes &= static_cast<uint16_t>(passes - 1);
+
+    ScanTarget target{};
+    wifi_scan_config_t scan_cfg = make_scan_config(options, channel, target);
+    {
+      EARBRAIN_TRACE_SCOPE("wifi.esp_wifi_scan_start");
+      err = esp_wifi_scan_start(&scan_cfg, true);
+    }
+    if (err != ESP_OK) {
+      break;
+    }
+
+    uint16_t ap_count = 0;
+    err = esp_wifi_scan_get_ap_num(&ap_count);
+    if (err != ESP_OK || ap_count == 0) {
+      continue;
+    }
+    const size_t offset = records.size();
+    records.resize(offset + ap_count);
+    err = esp_wifi_scan_get_ap_records(&ap_count, records.data() + offset);
+    records.resize(err == ESP_OK ? offset + ap_count : offset);
+  } while (err == ESP_OK && passes != 0);
+
   if (err != ESP_OK) {
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    blocking_scan = false;
     result.error = err;
     return result;
   }
 
-  // Build network list
-  result.networks.reserve(records.size());
+  result = summarize_scan(records);
+  // Only check for connected network if actually connected
+  for (auto &summary : result.networks) {
+    summary.connected = sta_connected && !credentials.ssid.empty() &&
+                        credentials.ssid == summary.ssid;
+  }
 
-  for (const auto &record : records) {
-    WifiNetworkSummary summary{};
+  std::lock_guard<std::mutex> lock(scan_mutex);
+  blocking_scan = false;
+  scan_cache = CachedScan{options, result, esp_timer_get_time()};
+  return result;
+}
 
-    // Check for hidden network first
-    const char *ssid_raw = reinterpret_cast<const char *>(record.ssid);
-    size_t ssid_len = ssid_raw ? strnlen(ssid_raw, sizeof(record.ssid)) : 0;
-    summary.hidden = (ssid_len == 0);
+void WifiService::clear_scan_cache() {
+  std::lock_guard<std::mutex> lock(scan_mutex);
+  scan_cache.reset();
+}
 
-    // Skip hidden networks (no SSID to display)
-    if (summary.hidden) {
-      continue;
+Future<WifiScanOutcome> WifiService::scan_async(std::span<wifi_ap_record_t> buffer,
+                                                ScanListener on_records,
+                                                const WifiScanOptions &options) {
+  wifi_mode_t native_mode = WIFI_MODE_NULL;
+  if (esp_wifi_get_mode(&native_mode) != ESP_OK || native_mode == WIFI_MODE_NULL) {
+    logging::warn("Cannot scan: WiFi not started", wifi_tag);
+    return make_ready_future(WifiScanOutcome{.error = ESP_ERR_INVALID_STATE});
+  }
+  if (buffer.empty() || (options.channels & ~WifiScanOptions::valid_channels) != 0) {
+    return make_ready_future(WifiScanOutcome{.error = ESP_ERR_INVALID_ARG});
+  }
+
+  uint16_t passes = options.channels;
+  if (options.per_channel && passes == 0) {
+    passes = country_channels();
+  }
+
+  Future<WifiScanOutcome> result;
+  {
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    if (scan_job || blocking_scan) {
+      return make_ready_future(WifiScanOutcome{.error = ESP_ERR_INVALID_STATE});
     }
+    scan_job.emplace();
+    scan_job->buffer = buffer;
+    scan_job->on_records = std::move(on_records);
+    scan_job->options = options;
+    scan_job->channel = passes ? static_cast<uint8_t>(std::countr_zero(passes)) : 0;
+    scan_job->remaining = passes & static_cast<uint16_t>(passes - 1);
+    result = scan_job->promise.future();
+  }
 
-    summary.ssid.assign(ssid_raw, ssid_len);
-    summary.bssid = format_bssid(record.bssid);
-    summary.rssi = record.rssi;
-    summary.signal = signal_quality_from_rssi(record.rssi);
-    summary.channel = record.primary;
-    summary.auth_mode = record.authmode;
+  const esp_err_t err = start_scan_pass();
+  if (err != ESP_OK) {
+    logging::errorf(wifi_tag, "Failed to start scan: %s", esp_err_to_name(err));
+    finish_scan(err);
+  }
+  return result;
+}
 
-    // Only check for connected network if actually connected
-    summary.connected = false;
-    if (sta_connected && !credentials.ssid.empty()) {
-      summary.connected = (credentials.ssid == summary.ssid);
+esp_err_t WifiService::start_scan_pass() {
+  ScanTarget target{};
+  wifi_scan_config_t scan_cfg{};
+  {
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    if (!scan_job) {
+      return ESP_ERR_INVALID_STATE;
     }
+    scan_cfg = make_scan_config(scan_job->options, scan_job->channel, target);
+  }
+  return esp_wifi_scan_start(&scan_cfg, false);
+}
 
-    result.networks.push_back(std::move(summary));
+void WifiService::on_scan_done(const wifi_event_sta_scan_done_t &event) {
+  const bool failed = event.status != 0;
+  WifiScanChunk chunk{};
+  ScanListener *listener = nullptr;
+  bool more = false;
+  {
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    // perform_scan() raises the same event; only async scans are tracked.
+    if (!scan_job) {
+      return;
+    }
+    if (!failed) {
+      ScanJob &job = *scan_job;
+      uint16_t found = 0;
+      esp_wifi_scan_get_ap_num(&found);
+      uint16_t room = static_cast<uint16_t>(job.buffer.size() - job.used);
+      uint16_t fetched = room;
+      // Also releases the driver's copy of the list.
+      if (esp_wifi_scan_get_ap_records(&fetched, job.buffer.data() + job.used) != ESP_OK) {
+        fetched = 0;
+      }
+      const uint16_t start = job.used;
+      job.used += fetched;
+      job.truncated = job.truncated || found > room;
+      more = job.remaining != 0 && !job.truncated && job.used < job.buffer.size();
+
+      // Without per_channel the listener sees the whole sweep once.
+      if (job.options.per_channel) {
+        chunk.channel = job.channel;
+        chunk.records = std::span<const wifi_ap_record_t>(job.buffer.data() + start, fetched);
+      } else if (!more) {
+        chunk.records = std::span<const wifi_ap_record_t>(job.buffer.data(), job.used);
+      }
+      if (job.on_records && !chunk.records.empty()) {
+        listener = &job.on_records;
+      }
+
+      if (more) {
+        job.channel = static_cast<uint8_t>(std::countr_zero(job.remaining));
+        job.remaining &= static_cast<uint16_t>(job.remaining - 1);
+      }
+    }
   }
 
-  // Sort by signal strength
-  std::sort(result.networks.begin(), result.networks.end(), [](const WifiNetworkSummary &a, const WifiNetworkSummary &b) {
-    return a.signal > b.signal;
-  });
+  // The job can only be finished from this task, so the listener stays put.
+  if (listener) {
+    (*listener)(chunk);
+  }
 
-  result.error = ESP_OK;
-  return result;
+  if (failed) {
+    finish_scan(ESP_FAIL);
+    return;
+  }
+  if (more) {
+    const esp_err_t err = start_scan_pass();
+    if (err != ESP_OK) {
+      finish_scan(err);
+    }
+    return;
+  }
+  finish_scan(ESP_OK);
+}
+
+void WifiService::finish_scan(esp_err_t error) {
+  std::optional<ScanJob> job;
+  {
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    job.swap(scan_job);
+  }
+  if (!job) {
+    return;
+  }
+  job->promise.set(WifiScanOutcome{
+      .error = error, .count = job->used, .truncated = job->truncated});
 }
 
 WifiStatus WifiService::status() const {
-  WifiStatus s;
-  s.mode = current_mode;
-  s.sta_connected = sta_connected.load();
-  s.sta_connecting = sta_connecting.load();
-  s.provisioning_active = provisioning_active.load();
-  s.sta_ip = sta_ip.load();
-  s.sta_last_disconnect_reason = sta_last_disconnect_reason.load();
-  s.sta_last_error = sta_last_error.load();
+  uint32_t generation = 0;
+  const StatusSnapshot snapshot = published_status.load(&generation);
+  WifiStatus s = snapshot.status;
+  s.generation = generation;
+  if (snapshot.reconnect_due_us != 0) {
+    s.next_reconnect_ms = static_cast<uint32_t>(
+        std::max<int64_t>(snapshot.reconnect_due_us - esp_timer_get_time(), 0) / 1000);
+  }
   return s;
 }
 
+uint32_t WifiService::status_generation() const { return published_status.generation(); }
+
 esp_err_t WifiService::start_provisioning(ProvisionMode mode, const ProvisioningOptions &opts) {
   if (provisioning_active.load()) {
     logging::warn("Provisioning is already active", wifi_tag);
     return ESP_ERR_INVALID_STATE;
   }
 
+  cancel_reconnect();
   current_provisioning_mode = mode;
 
   if (mode == ProvisionMode::SmartConfig) {
@@ -796,7 +1874,7 @@ esp_err_t WifiService::start_provisioning(ProvisionMode mode, const Provisioning
       return err;
     }
 
-    provisioning_active.store(true);
+    update_status([&] { provisioning_active.store(true); });
     logging::info("SmartConfig provisioning started", wifi_tag);
     return ESP_OK;
   } else if (mode == ProvisionMode::SoftAP) {
@@ -807,7 +1885,7 @@ esp_err_t WifiService::start_provisioning(ProvisionMode mode, const Provisioning
     ap_cfg.auth_mode = opts.ap_auth_mode;
     ap_cfg.max_connections = opts.ap_max_connections;
 
-    WifiConfig updated_config = wifi_config;
+    WifiConfig updated_config = config();
     updated_config.ap_config = ap_cfg;
     esp_err_t err = config(updated_config);
     if (err != ESP_OK) {
@@ -819,7 +1897,7 @@ esp_err_t WifiService::start_provisioning(ProvisionMode mode, const Provisioning
       return err;
     }
 
-    provisioning_active.store(true);
+    update_status([&] { provisioning_active.store(true); });
     logging::info("SoftAP provisioning started", wifi_tag);
     return ESP_OK;
   }
@@ -846,7 +1924,7 @@ esp_err_t WifiService::cancel_provisioning() {
                                  &WifiService::provisioning_event_handler);
   }
 
-  provisioning_active.store(false);
+  update_status([&] { provisioning_active.store(false); });
   logging::info("Provisioning cancelled", wifi_tag);
   return ESP_OK;
 }
@@ -884,7 +1962,7 @@ void WifiService::provisioning_event_handler(void *arg,
                                    &WifiService::provisioning_event_handler);
       esp_event_handler_unregister(SC_EVENT, SC_EVENT_SEND_ACK_DONE,
                                    &WifiService::provisioning_event_handler);
-      wifi->provisioning_active.store(false);
+      wifi->update_status([&] { wifi->provisioning_active.store(false); });
     }
     break;
   default:
@@ -934,12 +2012,17 @@ void WifiService::on_provisioning_done(void *event_data) {
   creds_event.sta_connecting = sta_connecting.load();
   creds_event.provisioning_active = provisioning_active.load();
   creds_event.event = WifiEvent::ProvisioningCredentialsReceived;
-  creds_event.credentials = temp_provisioning_credentials;
+  if (wants(WifiEvent::ProvisioningCredentialsReceived)) {
+    creds_event.credentials =
+        make_tracked_shared<WifiCredentials>(*temp_provisioning_credentials);
+  }
   emit(creds_event);
 
-  sta_connecting.store(true);
+  // The provisioned network replaces whatever connect() was after.
+  begin_attempt();
+  update_status([&] { sta_connecting.store(true); });
 
-  wifi_config_t sta_cfg = make_sta_config(*temp_provisioning_credentials);
+  wifi_config_t sta_cfg = make_sta_config(*temp_provisioning_credentials, sta_listen_interval.load());
   esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
   if (err != ESP_OK) {
     logging::errorf(wifi_tag, "Failed to configure STA interface: %s",
@@ -977,15 +2060,125 @@ void WifiService::on_provisioning_done(void *event_data) {
   logging::info("Provisioning: Connection initiated, waiting for IP address...", wifi_tag);
 }
 
+bool WifiService::wants(WifiEvent event) const {
+  return (subscribed_events.load() & wifi_event_mask(event)) != 0;
+}
+
 void WifiService::emit(const WifiEventData &data) const {
-  for (const auto &listener : listeners) {
-    listener(data);
+  if (!wants(data.event)) {
+    return;
+  }
+  TaskHandle_t task = event_dispatch->task.load();
+  if (!task) {
+    // The dispatcher task could not be created; fall back to the caller.
+    deliver(data);
+    return;
+  }
+  if (!event_dispatch->queue.try_push([&](WifiEventData &slot) { slot = data; })) {
+    const uint32_t dropped = event_dispatch->dropped.fetch_add(1) + 1;
+    logging::warnf(wifi_tag, "Event queue full, dropped event %d (%lu so far)",
+                   static_cast<int>(data.event), static_cast<unsigned long>(dropped));
+    return;
+  }
+  xTaskNotifyGive(task);
+}
+
+void WifiService::deliver(const WifiEventData &data) const {
+  std::shared_ptr<const SubscriptionList> current;
+  {
+    std::lock_guard<std::mutex> lock(listeners_mutex);
+    current = listeners;
+  }
+  if (!current) {
+    return;
+  }
+  const WifiEventMask bit = wifi_event_mask(data.event);
+  for (const Subscription &subscription : *current) {
+    if (subscription.events & bit) {
+      EARBRAIN_TRACE_SCOPE("wifi.listener");
+      subscription.listener(data);
+    }
+  }
+}
+
+// Callers hold listeners_mutex.
+void WifiService::start_event_task() {
+  if (event_dispatch->task.load()) {
+    return;
+  }
+  TaskHandle_t task = nullptr;
+  if (xTaskCreate(&WifiService::event_task, "wifi_events",
+                  CONFIG_EARBRAIN_WIFI_EVENT_TASK_STACK_SIZE, this,
+                  CONFIG_EARBRAIN_WIFI_EVENT_TASK_PRIORITY, &task) != pdPASS) {
+    logging::warn("Failed to start event task; listeners run on the event loop",
+                  wifi_tag);
+    return;
+  }
+  event_dispatch->task.store(task);
+}
+
+void WifiService::event_task(void *arg) {
+  auto *self = static_cast<WifiService *>(arg);
+  WifiEventData event;
+  for (;;) {
+    while (self->event_dispatch->queue.try_pop([&](WifiEventData &slot) {
+      event = std::move(slot);
+      slot.credentials.reset();
+    })) {
+      self->deliver(event);
+      event.credentials.reset();
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+WifiSubscriptionId WifiService::subscribe(EventListener listener, WifiEventMask events) {
+  if (!listener || events == 0) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(listeners_mutex);
+  start_event_task();
+
+  auto next = listeners ? make_tracked_shared<SubscriptionList>(*listeners)
+                        : make_tracked_shared<SubscriptionList>();
+  const WifiSubscriptionId id = next_subscription_id++;
+  next->push_back(Subscription{id, events, std::move(listener)});
+  listeners = std::move(next);
+  subscribed_events.fetch_or(events);
+  return id;
+}
+
+WifiSubscriptionId WifiService::subscribe(WifiEvent event, EventListener listener) {
+  return subscribe(std::move(listener), wifi_event_mask(event));
+}
+
+bool WifiService::unsubscribe(WifiSubscriptionId id) {
+  std::lock_guard<std::mutex> lock(listeners_mutex);
+  if (!listeners || id == 0) {
+    return false;
   }
+
+  auto next = make_tracked_shared<SubscriptionList>();
+  WifiEventMask events = 0;
+  for (const Subscription &subscription : *listeners) {
+    if (subscription.id != id) {
+      next->push_back(subscription);
+      events |= subscription.events;
+    }
+  }
+  if (next->size() == listeners->size()) {
+    return false;
+  }
+  listeners = std::move(next);
+  subscribed_events.store(events);
+  return true;
 }
 
 void WifiService::emit_connection_failed(esp_err_t error) {
-  sta_last_error = error;
-  sta_connecting.store(false); // Reset connecting flag
+  update_status([&] {
+    sta_last_error = error;
+    sta_connecting.store(false); // Reset connecting flag
+  });
 
   WifiEventData event_data{};
   event_data.mode = current_mode;
@@ -997,8 +2190,8 @@ void WifiService::emit_connection_failed(esp_err_t error) {
   emit(event_data);
 }
 
-void WifiService::on(EventListener listener) {
-  listeners.push_back(std::move(listener));
+WifiSubscriptionId WifiService::on(EventListener listener) {
+  return subscribe(std::move(listener));
 }
 
 WifiService &wifi() {
@@ -0,0 +1,269 @@
+#include "earbrain/wifi_telemetry.hpp"
+#include "earbrain/wifi_service.hpp"
+
+#include <atomic>
+
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "esp_wifi.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+namespace earbrain {
+
+namespace {
+
+// Filled in by the hooks below; they have no context argument, and there
+// is only one STA netif.
+struct LinkCounters {
+  std::atomic<uint32_t> rx_bytes{0};
+  std::atomic<uint32_t> tx_bytes{0};
+  std::atomic<uint32_t> rx_packets{0};
+  std::atomic<uint32_t> tx_packets{0};
+  netif_input_fn input = nullptr;
+  netif_linkoutput_fn linkoutput = nullptr;
+};
+
+LinkCounters counters;
+
+err_t counted_input(struct pbuf *p, struct netif *netif) {
+  counters.rx_bytes.fetch_add(p->tot_len, std::memory_order_relaxed);
+  counters.rx_packets.fetch_add(1, std::memory_order_relaxed);
+  return counters.input(p, netif);
+}
+
+err_t counted_linkoutput(struct netif *netif, struct pbuf *p) {
+  counters.tx_bytes.fetch_add(p->tot_len, std::memory_order_relaxed);
+  counters.tx_packets.fetch_add(1, std::memory_order_relaxed);
+  return counters.linkoutput(netif, p);
+}
+
+// Run on the TCP/IP thread. The saved pointers are written before the
+// hooks are switched in and never cleared, since the Wi-Fi task may still
+// be inside counted_input() while the hook is removed.
+esp_err_t install_hooks(void *ctx) {
+  auto *netif = static_cast<struct netif *>(ctx);
+  if (netif->input != &counted_input) {
+    counters.input = netif->input;
+    netif->input = &counted_input;
+  }
+  if (netif->linkoutput != &counted_linkoutput) {
+    counters.linkoutput = netif->linkoutput;
+    netif->linkoutput = &counted_linkoutput;
+  }
+  return ESP_OK;
+}
+
+esp_err_t remove_hooks(void *ctx) {
+  auto *netif = static_cast<struct netif *>(ctx);
+  if (netif->input == &counted_input) {
+    netif->input = counters.input;
+  }
+  if (netif->linkoutput == &counted_linkoutput) {
+    netif->linkoutput = counters.linkoutput;
+  }
+  return ESP_OK;
+}
+
+struct netif *sta_lwip_netif() {
+  esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  return netif ? static_cast<struct netif *>(esp_netif_get_netif_impl(netif)) : nullptr;
+}
+
+// Blocks until the TCP/IP thread has run the hook change, so this is only
+// called from start() and the listener task. The Wi-Fi service recreates
+// the STA netif on mode changes; the Connected event that follows hooks the
+// new one.
+void hook_sta_netif() {
+  if (struct netif *netif = sta_lwip_netif();
+      netif && (netif->input != &counted_input || netif->linkoutput != &counted_linkoutput)) {
+    esp_netif_tcpip_exec(&install_hooks, netif);
+  }
+}
+
+WifiPhy phy_of(const wifi_ap_record_t &ap) {
+  if (ap.phy_lr) return WifiPhy::LR;
+  if (ap.phy_11ax) return WifiPhy::AX;
+  if (ap.phy_11n) return WifiPhy::N;
+  if (ap.phy_11g) return WifiPhy::G;
+  if (ap.phy_11b) return WifiPhy::B;
+  return WifiPhy::Unknown;
+}
+
+uint32_t per_second(uint32_t delta, uint32_t interval_ms) {
+  return interval_ms > 0
+             ? static_cast<uint32_t>(static_cast<uint64_t>(delta) * 1000 / interval_ms)
+             : 0;
+}
+
+} // namespace
+
+WifiTelemetry::~WifiTelemetry() { stop(); }
+
+esp_err_t WifiTelemetry::start(uint32_t period_ms) {
+  if (period_ms == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (running) {
+    const esp_err_t stop_err = stop();
+    if (stop_err != ESP_OK) {
+      return stop_err;
+    }
+  }
+
+  if (!timer) {
+    esp_timer_create_args_t args{};
+    args.callback = &WifiTelemetry::on_timer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "wifi_telemetry";
+    args.skip_unhandled_events = true;
+
+    const esp_err_t err = esp_timer_create(&args, &timer);
+    if (err != ESP_OK) {
+      timer = nullptr;
+      return err;
+    }
+  }
+
+  const bool connected = wifi().status().sta_connected;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    connected_since_us = connected ? esp_timer_get_time() : 0;
+  }
+  if (connected) {
+    hook_sta_netif();
+  }
+  const WifiEventMask events =
+      wifi_event_mask(WifiEvent::Connected) | wifi_event_mask(WifiEvent::Disconnected);
+  subscription =
+      wifi().subscribe([this](const WifiEventData &event) { on_event(event); }, events);
+
+  const esp_err_t err =
+      esp_timer_start_periodic(timer, static_cast<uint64_t>(period_ms) * 1000);
+  if (err != ESP_OK) {
+    wifi().unsubscribe(subscription);
+    subscription = 0;
+    return err;
+  }
+
+  period = period_ms;
+  running = true;
+  sample();
+  return ESP_OK;
+}
+
+esp_err_t WifiTelemetry::stop() {
+  if (subscription != 0) {
+    wifi().unsubscribe(subscription);
+    subscription = 0;
+  }
+  if (struct netif *netif = sta_lwip_netif()) {
+    esp_netif_tcpip_exec(&remove_hooks, netif);
+  }
+
+  if (!timer) {
+    return ESP_OK;
+  }
+
+  esp_err_t err = esp_timer_stop(timer);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    return err;
+  }
+  err = esp_timer_delete(timer);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  timer = nullptr;
+  running = false;
+  return ESP_OK;
+}
+
+void WifiTelemetry::on_timer(void *arg) {
+  static_cast<WifiTelemetry *>(arg)->sample();
+}
+
+void WifiTelemetry::sample() {
+  WifiLinkSample sample{};
+  sample.timestamp_ms = static_cast<uint32_t>(esp_timer_get_time() / 1000);
+
+  wifi_ap_record_t ap{};
+  if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+    sample.associated = true;
+    sample.rssi = ap.rssi;
+    sample.channel = ap.primary;
+    sample.phy = phy_of(ap);
+  }
+  sample.reconnects_total = wifi().status().reconnects_total;
+
+  sample.rx_bytes = counters.rx_bytes.load(std::memory_order_relaxed);
+  sample.tx_bytes = counters.tx_bytes.load(std::memory_order_relaxed);
+  sample.rx_packets = counters.rx_packets.load(std::memory_order_relaxed);
+  sample.tx_packets = counters.tx_packets.load(std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (const WifiLinkSample *previous = samples.latest()) {
+    const uint32_t interval_ms = sample.timestamp_ms - previous->timestamp_ms;
+    sample.rx_bytes_per_s = per_second(sample.rx_bytes - previous->rx_bytes, interval_ms);
+    sample.tx_bytes_per_s = per_second(sample.tx_bytes - previous->tx_bytes, interval_ms);
+  }
+  samples.push(sample);
+}
+
+// Runs on the Wi-Fi listener task.
+void WifiTelemetry::on_event(const WifiEventData &event) {
+  const int64_t now_us = esp_timer_get_time();
+
+  if (event.event == WifiEvent::Connected) {
+    hook_sta_netif();
+    std::lock_guard<std::mutex> lock(mutex);
+    connected_since_us = now_us;
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  WifiDisconnectRecord record{};
+  record.timestamp_ms = static_cast<uint32_t>(now_us / 1000);
+  record.reason = event.disconnect_reason.value_or(WIFI_REASON_UNSPECIFIED);
+  if (const WifiLinkSample *last = samples.latest(); last && last->associated) {
+    record.rssi = last->rssi;
+  }
+  if (connected_since_us != 0) {
+    record.connected_ms = static_cast<uint32_t>((now_us - connected_since_us) / 1000);
+  }
+  connected_since_us = 0;
+  disconnect_history.push(record);
+}
+
+std::optional<WifiLinkSample> WifiTelemetry::latest() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (const WifiLinkSample *sample = samples.latest()) {
+    return *sample;
+  }
+  return std::nullopt;
+}
+
+SeriesBatch<WifiLinkSample> WifiTelemetry::collect(uint64_t cursor, std::size_t limit) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return samples.collect(cursor, limit);
+}
+
+SeriesBatch<WifiDisconnectRecord> WifiTelemetry::disconnects(uint64_t cursor,
+                                                             std::size_t limit) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return disconnect_history.collect(cursor, limit);
+}
+
+void WifiTelemetry::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  samples.clear();
+  disconnect_history.clear();
+}
+
+WifiTelemetry &wifi_telemetry() {
+  static WifiTelemetry instance;
+  return instance;
+}
+
+} // namespace earbrain